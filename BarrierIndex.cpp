@@ -0,0 +1,594 @@
+#include <limits>
+#include <vector>
+#include <algorithm>
+#include "BarrierIndex.h"
+
+using namespace oa;
+using namespace std;
+
+// barriers inserted before they are merged into the levels, level k holds
+// at most PENDING_MAX << k barriers
+static const size_t PENDING_MAX = 64;
+// pending barriers are compared in blocks of this size
+static const size_t SCAN_BLOCK = 64;
+// barriers next to the query position tried in each level before its tree
+static const size_t NEAR_PROBES = 8;
+
+void
+BarrierIndex_t::Columns_t::clear()
+{
+    coord.clear();
+    low.clear();
+    high.clear();
+    netID.clear();
+    seq.clear();
+    seg.clear();
+}
+
+void
+BarrierIndex_t::Columns_t::reserve(size_t n)
+{
+    coord.reserve(n);
+    low.reserve(n);
+    high.reserve(n);
+    netID.reserve(n);
+    seq.reserve(n);
+    seg.reserve(n);
+}
+
+void
+BarrierIndex_t::Columns_t::append(const Columns_t &from, size_t i)
+{
+    coord.push_back(from.coord[i]);
+    low.push_back(from.low[i]);
+    high.push_back(from.high[i]);
+    netID.push_back(from.netID[i]);
+    seq.push_back(from.seq[i]);
+    seg.push_back(from.seg[i]);
+}
+
+// the barriers of lhs and rhs, both sorted by (coord, seq), in that order
+void
+BarrierIndex_t::Columns_t::merge(const Columns_t &lhs, const Columns_t &rhs)
+{
+    clear();
+    reserve(lhs.size() + rhs.size());
+    size_t i = 0, j = 0;
+    while (i < lhs.size() || j < rhs.size()) {
+        if (j == rhs.size() || (i < lhs.size() && (lhs.coord[i] < rhs.coord[j] || \
+                        (lhs.coord[i] == rhs.coord[j] && lhs.seq[i] < rhs.seq[j])))) {
+            append(lhs, i++);
+        }
+        else {
+            append(rhs, j++);
+        }
+    }
+}
+
+void
+BarrierIndex_t::Columns_t::swap(Columns_t &other)
+{
+    coord.swap(other.coord);
+    low.swap(other.low);
+    high.swap(other.high);
+    netID.swap(other.netID);
+    seq.swap(other.seq);
+    seg.swap(other.seg);
+}
+
+// orders positions of a Columns_t by (coord, seq)
+class ColumnsComparator {
+public:
+    ColumnsComparator(const vector<oaCoord> &coord, const vector<oaUInt4> &seq)
+        : _coord(coord), _seq(seq) {}
+    bool operator()(size_t lhs, size_t rhs) const {
+        return _coord[lhs] < _coord[rhs] || \
+               (_coord[lhs] == _coord[rhs] && _seq[lhs] < _seq[rhs]);
+    }
+private:
+    const vector<oaCoord> &_coord;
+    const vector<oaUInt4> &_seq;
+};
+
+// the canonical nodes of the slots [from, to) in a tree over leaves slots
+class CanonicalNodes {
+public:
+    CanonicalNodes(size_t leaves, size_t from, size_t to)
+        : _low(from + leaves), _high(to + leaves) {}
+    // the next node, 0 when done
+    size_t next() {
+        while (_low < _high) {
+            if (_low & 1) {
+                return _low++;
+            }
+            if (_high & 1) {
+                return --_high;
+            }
+            _low >>= 1;
+            _high >>= 1;
+        }
+        return 0;
+    }
+private:
+    size_t _low;
+    size_t _high;
+};
+
+// keep in best the candidate nearest to the start in direction dir
+static void
+keepNearest(oaCoord candidate, int dir, bool &found, oaCoord &best)
+{
+    if (!found || (dir > 0 ? candidate < best : candidate > best)) {
+        best = candidate;
+        found = true;
+    }
+}
+
+// nearest value of a sorted vector strictly after/before pos
+static void
+nearestSorted(const vector<oaCoord> &values, oaCoord pos, int dir, bool &found, \
+        oaCoord &best)
+{
+    if (dir > 0) {
+        vector<oaCoord>::const_iterator it = upper_bound(values.begin(), \
+                values.end(), pos);
+        if (it != values.end()) {
+            keepNearest(*it, dir, found, best);
+        }
+    }
+    else {
+        vector<oaCoord>::const_iterator it = lower_bound(values.begin(), \
+                values.end(), pos);
+        if (it != values.begin()) {
+            keepNearest(*(--it), dir, found, best);
+        }
+    }
+}
+
+void
+BarrierIndex_t::Level_t::clear()
+{
+    sorted.clear();
+    sortedLows.clear();
+    sortedHighs.clear();
+    bounds.clear();
+    leaves = 0;
+    first.clear();
+    entries.clear();
+    runs.clear();
+}
+
+// take barriers, sorted by (coord, seq), and build the tree over them.
+// A barrier covers across for low - margin < across < high + margin,
+// the half-open [low - margin + 1, high + margin): these bounds cut the
+// across axis into the slots.
+void
+BarrierIndex_t::Level_t::build(Columns_t &barriers, oaInt4 margin)
+{
+    clear();
+    sorted.swap(barriers);
+    size_t n = sorted.size();
+    sortedLows = sorted.low;
+    sortedHighs = sorted.high;
+    sort(sortedLows.begin(), sortedLows.end());
+    sort(sortedHighs.begin(), sortedHighs.end());
+
+    // the span ends, (value, 2 * i) for the first of barrier i and
+    // (value, 2 * i + 1) for its end, are ranked by one sort
+    vector<pair<oaCoord, oaUInt4> > ends;
+    ends.reserve(2 * n);
+    for (size_t i = 0; i < n; ++i) {
+        if (sorted.low[i] - margin + 1 < sorted.high[i] + margin) {
+            ends.push_back(make_pair(sorted.low[i] - margin + 1, 2 * i));
+            ends.push_back(make_pair(sorted.high[i] + margin, 2 * i + 1));
+        }
+    }
+    sort(ends.begin(), ends.end());
+    // slot range [slots[2 * i], slots[2 * i + 1]) of barrier i, empty for
+    // an empty span
+    vector<oaUInt4> slots(2 * n, 0);
+    bounds.reserve(ends.size());
+    for (size_t j = 0; j < ends.size(); ++j) {
+        if (bounds.empty() || bounds.back() != ends[j].first) {
+            bounds.push_back(ends[j].first);
+        }
+        slots[ends[j].second] = bounds.size() - 1;
+    }
+    vector<pair<oaCoord, oaUInt4> >().swap(ends);
+    leaves = bounds.empty() ? 0 : bounds.size() - 1;
+
+    // first[node + 1] counts the entries of node, then the prefix sums
+    first.assign(2 * leaves + 1, 0);
+    for (size_t i = 0; i < n; ++i) {
+        CanonicalNodes nodes(leaves, slots[2 * i], slots[2 * i + 1]);
+        for (size_t node = nodes.next(); node != 0; node = nodes.next()) {
+            ++first[node + 1];
+        }
+    }
+    for (size_t node = 1; node < first.size(); ++node) {
+        first[node] += first[node - 1];
+    }
+    // filled in position order, so each node's entries come out sorted;
+    // runs holds their nets until the runs are known
+    entries.resize(first.back());
+    runs.resize(entries.size());
+    vector<oaUInt4> cursor(first.begin(), first.end() - 1);
+    for (size_t i = 0; i < n; ++i) {
+        CanonicalNodes nodes(leaves, slots[2 * i], slots[2 * i + 1]);
+        for (size_t node = nodes.next(); node != 0; node = nodes.next()) {
+            runs[cursor[node]] = sorted.netID[i];
+            entries[cursor[node]++] = i;
+        }
+    }
+    for (size_t node = 1; node + 1 < first.size(); ++node) {
+        size_t end = first[node + 1];
+        for (size_t begin = first[node]; begin < end; ) {
+            size_t last = begin;
+            while (last + 1 < end && runs[last + 1] == runs[begin]) {
+                ++last;
+            }
+            runs[begin] = last;
+            for (size_t k = begin + 1; k <= last; ++k) {
+                runs[k] = begin;
+            }
+            begin = last + 1;
+        }
+    }
+}
+
+// the nodes covering across are the ancestors of its slot: in each, the
+// last entry below limitBefore and the first at or above limitAfter are
+// binary searched, then moved to the nearest entry of another net if they
+// belong to excludeNet
+void
+BarrierIndex_t::Level_t::stab(oaCoord across, oaInt4 excludeNet, size_t limitBefore, \
+        size_t limitAfter, long &bestBefore, long &bestAfter) const
+{
+    vector<oaCoord>::const_iterator bound = upper_bound(bounds.begin(), bounds.end(), \
+            across);
+    if (bound == bounds.begin() || bound == bounds.end()) {
+        return;
+    }
+    size_t slot = (bound - bounds.begin()) - 1;
+    const oaUInt4 *list = &entries[0];
+    for (size_t node = slot + leaves; node > 0; node >>= 1) {
+        const oaUInt4 *begin = list + first[node];
+        const oaUInt4 *end = list + first[node + 1];
+        if (begin == end) {
+            continue;
+        }
+        const oaUInt4 *at = begin;
+        if (limitBefore > 0) {
+            at = lower_bound(begin, end, limitBefore);
+            if (at != begin) {
+                long k = (at - 1) - list;
+                if (sorted.netID[list[k]] == excludeNet) {
+                    k = runFirst(k) - 1;
+                }
+                if (k >= static_cast<long>(first[node]) && \
+                        static_cast<long>(list[k]) > bestBefore) {
+                    bestBefore = list[k];
+                }
+            }
+        }
+        if (limitAfter < sorted.size()) {
+            at = lower_bound(at, end, limitAfter);
+            if (at != end) {
+                long k = at - list;
+                if (sorted.netID[list[k]] == excludeNet) {
+                    k = runs[runFirst(k)] + 1;
+                }
+                if (k < static_cast<long>(first[node + 1]) && \
+                        (bestAfter < 0 || static_cast<long>(list[k]) < bestAfter)) {
+                    bestAfter = list[k];
+                }
+            }
+        }
+    }
+}
+
+BarrierIndex_t::BarrierIndex_t()
+    : _levels(), _pending(), _seq(0), _margin(0), _bulk(false)
+{
+}
+
+void
+BarrierIndex_t::setMargin(oaInt4 margin)
+{
+    if (margin != _margin) {
+        _margin = margin;
+        rebuildAll(numeric_limits<oaInt4>::min());
+    }
+}
+
+size_t
+BarrierIndex_t::size() const
+{
+    size_t n = _pending.size();
+    for (size_t k = 0; k < _levels.size(); ++k) {
+        n += _levels[k]->sorted.size();
+    }
+    return n;
+}
+
+void
+BarrierIndex_t::insert(oaCoord coord, oaCoord low, oaCoord high, oaInt4 netID, \
+        const line_t &seg)
+{
+    _pending.coord.push_back(coord);
+    _pending.low.push_back(low);
+    _pending.high.push_back(high);
+    _pending.netID.push_back(netID);
+    _pending.seq.push_back(_seq++);
+    _pending.seg.push_back(seg);
+    if (_pending.size() >= PENDING_MAX && !_bulk) {
+        flush();
+    }
+}
+
+void
+BarrierIndex_t::endBulk()
+{
+    _bulk = false;
+    flush();
+}
+
+void
+BarrierIndex_t::clear()
+{
+    _levels.clear();
+    _pending.clear();
+    _seq = 0;
+}
+
+void
+BarrierIndex_t::eraseNet(oaInt4 netID)
+{
+    rebuildAll(netID);
+}
+
+// the pending barriers, sorted, are carried up the levels: each non-empty
+// level is merged in and emptied, until the carry fits an empty level
+void
+BarrierIndex_t::flush()
+{
+    if (_pending.empty()) {
+        return;
+    }
+    vector<size_t> order(_pending.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    sort(order.begin(), order.end(), ColumnsComparator(_pending.coord, _pending.seq));
+    Columns_t carry;
+    carry.reserve(order.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        carry.append(_pending, order[i]);
+    }
+    if (_pending.size() > PENDING_MAX) {
+        // a bulk load or a rebuild, give its buffer back
+        Columns_t().swap(_pending);
+    }
+    else {
+        _pending.clear();
+    }
+
+    size_t k = 0;
+    for (;; ++k) {
+        if (k == _levels.size()) {
+            _levels.push_back(CowPtr_t<Level_t>());
+        }
+        const Columns_t &level = _levels[k]->sorted;
+        if (!level.empty()) {
+            Columns_t merged;
+            merged.merge(carry, level);
+            carry.swap(merged);
+            // copies of this index keep theirs
+            _levels[k] = CowPtr_t<Level_t>();
+        }
+        if (carry.size() <= (PENDING_MAX << k)) {
+            break;
+        }
+    }
+    _levels[k].reset().build(carry, _margin);
+}
+
+void
+BarrierIndex_t::rebuildAll(oaInt4 skipNet)
+{
+    Columns_t kept;
+    kept.reserve(size());
+    for (size_t k = 0; k < _levels.size(); ++k) {
+        const Columns_t &level = _levels[k]->sorted;
+        for (size_t i = 0; i < level.size(); ++i) {
+            if (level.netID[i] != skipNet) {
+                kept.append(level, i);
+            }
+        }
+    }
+    for (size_t i = 0; i < _pending.size(); ++i) {
+        if (_pending.netID[i] != skipNet) {
+            kept.append(_pending, i);
+        }
+    }
+    _levels.clear();
+    _pending.swap(kept);
+    flush();
+}
+
+// nearest barriers of all levels and of the pending ones: the larger
+// (coord, seq) before pos, the smaller after it
+void
+BarrierIndex_t::find(oaCoord pos, oaCoord across, oaInt4 excludeNet, bool wantBefore, \
+        bool wantAfter, Hit_t &before, Hit_t &after) const
+{
+    for (size_t k = 0; k < _levels.size(); ++k) {
+        const Level_t &level = *_levels[k];
+        const Columns_t &sorted = level.sorted;
+        if (sorted.empty()) {
+            continue;
+        }
+        size_t limitBefore = 0;
+        size_t limitAfter = sorted.size();
+        if (wantBefore) {
+            limitBefore = lower_bound(sorted.coord.begin(), sorted.coord.end(), pos) - \
+                          sorted.coord.begin();
+        }
+        if (wantAfter) {
+            limitAfter = upper_bound(sorted.coord.begin() + limitBefore, \
+                    sorted.coord.end(), pos) - sorted.coord.begin();
+        }
+        // the nearest barrier is usually one of the first few in order,
+        // the tree is searched only for a side none of them covers
+        long b = -1, a = -1;
+        for (size_t i = limitBefore; i > 0 && limitBefore - i < NEAR_PROBES; --i) {
+            if (sorted.netID[i - 1] != excludeNet && sorted.low[i - 1] - _margin < across && \
+                    across < sorted.high[i - 1] + _margin) {
+                b = i - 1;
+                break;
+            }
+        }
+        for (size_t i = limitAfter; i < sorted.size() && i - limitAfter < NEAR_PROBES; ++i) {
+            if (sorted.netID[i] != excludeNet && sorted.low[i] - _margin < across && \
+                    across < sorted.high[i] + _margin) {
+                a = i;
+                break;
+            }
+        }
+        level.stab(across, excludeNet, (b < 0) ? limitBefore : 0, \
+                (a < 0) ? limitAfter : sorted.size(), b, a);
+        if (b >= 0 && (before.seg == NULL || sorted.coord[b] > before.coord || \
+                    (sorted.coord[b] == before.coord && sorted.seq[b] > before.seq))) {
+            before.coord = sorted.coord[b];
+            before.seq = sorted.seq[b];
+            before.seg = &sorted.seg[b];
+        }
+        if (a >= 0 && (after.seg == NULL || sorted.coord[a] < after.coord || \
+                    (sorted.coord[a] == after.coord && sorted.seq[a] < after.seq))) {
+            after.coord = sorted.coord[a];
+            after.seq = sorted.seq[a];
+            after.seg = &sorted.seg[a];
+        }
+    }
+
+    // the span compares of the pending barriers are done a block at a
+    // time in a branch-free loop the compiler can vectorise, then the hits
+    // of the block are reduced; pending ones are newer than all others
+    size_t n = _pending.size();
+    oaCoord upper = across + _margin;
+    oaCoord lower = across - _margin;
+    unsigned char hit[SCAN_BLOCK];
+    for (size_t base = 0; base < n; base += SCAN_BLOCK) {
+        size_t count = min(SCAN_BLOCK, n - base);
+        const oaCoord *coord = &_pending.coord[base];
+        const oaCoord *low = &_pending.low[base];
+        const oaCoord *high = &_pending.high[base];
+        const oaInt4 *netID = &_pending.netID[base];
+
+        for (size_t i = 0; i < count; ++i) {
+            hit[i] = (netID[i] != excludeNet) & (low[i] < upper) & (high[i] > lower);
+        }
+        for (size_t i = 0; i < count; ++i) {
+            if (!hit[i]) {
+                continue;
+            }
+            if (wantBefore && coord[i] < pos && \
+                    (before.seg == NULL || coord[i] >= before.coord)) {
+                before.coord = coord[i];
+                before.seq = _pending.seq[base + i];
+                before.seg = &_pending.seg[base + i];
+            }
+            else if (wantAfter && coord[i] > pos && \
+                    (after.seg == NULL || coord[i] < after.coord)) {
+                after.coord = coord[i];
+                after.seq = _pending.seq[base + i];
+                after.seg = &_pending.seg[base + i];
+            }
+        }
+    }
+}
+
+bool
+BarrierIndex_t::findBefore(oaCoord pos, oaCoord across, oaInt4 excludeNet, \
+        line_t &seg) const
+{
+    Hit_t before, after;
+    find(pos, across, excludeNet, true, false, before, after);
+    if (before.seg != NULL) {
+        seg = *before.seg;
+    }
+    return before.seg != NULL;
+}
+
+bool
+BarrierIndex_t::findAfter(oaCoord pos, oaCoord across, oaInt4 excludeNet, \
+        line_t &seg) const
+{
+    Hit_t before, after;
+    find(pos, across, excludeNet, false, true, before, after);
+    if (after.seg != NULL) {
+        seg = *after.seg;
+    }
+    return after.seg != NULL;
+}
+
+void
+BarrierIndex_t::findAround(oaCoord pos, oaCoord across, oaInt4 excludeNet, \
+        line_t &before, line_t &after) const
+{
+    Hit_t nearBefore, nearAfter;
+    find(pos, across, excludeNet, true, true, nearBefore, nearAfter);
+    if (nearBefore.seg != NULL) {
+        before = *nearBefore.seg;
+    }
+    if (nearAfter.seg != NULL) {
+        after = *nearAfter.seg;
+    }
+}
+
+bool
+BarrierIndex_t::nextCoord(oaCoord pos, int dir, oaCoord &next) const
+{
+    bool found = false;
+    for (size_t k = 0; k < _levels.size(); ++k) {
+        nearestSorted(_levels[k]->sorted.coord, pos, dir, found, next);
+    }
+    for (size_t i = 0; i < _pending.size(); ++i) {
+        oaCoord coord = _pending.coord[i];
+        if (dir > 0 ? coord > pos : coord < pos) {
+            keepNearest(coord, dir, found, next);
+        }
+    }
+    return found;
+}
+
+bool
+BarrierIndex_t::nextSpanBound(oaCoord across, int dir, oaCoord &next) const
+{
+    // a point enters a widened span at low - margin and leaves it at
+    // high + margin
+    bool found = false;
+    for (size_t k = 0; k < _levels.size(); ++k) {
+        oaCoord bound;
+        bool lowFound = false, highFound = false;
+        nearestSorted(_levels[k]->sortedLows, across + _margin, dir, lowFound, bound);
+        if (lowFound) {
+            keepNearest(bound - _margin, dir, found, next);
+        }
+        nearestSorted(_levels[k]->sortedHighs, across - _margin, dir, highFound, bound);
+        if (highFound) {
+            keepNearest(bound + _margin, dir, found, next);
+        }
+    }
+    for (size_t i = 0; i < _pending.size(); ++i) {
+        oaCoord enter = _pending.low[i] - _margin;
+        oaCoord leave = _pending.high[i] + _margin;
+        if (dir > 0 ? enter > across : enter < across) {
+            keepNearest(enter, dir, found, next);
+        }
+        if (dir > 0 ? leave > across : leave < across) {
+            keepNearest(leave, dir, found, next);
+        }
+    }
+    return found;
+}
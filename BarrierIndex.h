@@ -0,0 +1,136 @@
+// The class BarrierIndex_t answers the cover queries of the line-probing
+// algorithm: "the nearest barrier before/after a coordinate whose span
+// covers a point". Barriers are kept in levels of doubling size, each
+// sorted by its coordinate under a stabbing tree over the across axis: a
+// segment tree over the widened span bounds whose nodes list, in coordinate
+// order, the barriers spanning them. A query visits the O(log n) nodes
+// above the point's slot and binary searches each list, the nearest entry
+// of another net is stored with every entry so the querying net is skipped
+// in O(1). Levels are never changed in place, copies of an index share
+// them: a copy costs the few pending barriers only, which is what makes
+// Router_t savepoints and forks cheap.
+#ifndef BARRIERINDEX_H_
+#define BARRIERINDEX_H_
+
+#include <vector>
+#include "Geometry.h"
+#include "line.h"
+#include "CowPtr.h"
+
+class BarrierIndex_t {
+public:
+    BarrierIndex_t();
+    // clearance the spans are widened by in the queries, the levels are
+    // built for one margin: changing it rebuilds them
+    void setMargin(oa::oaInt4 margin);
+    oa::oaInt4 margin() const { return _margin; }
+    // coord: position of the barrier along the query axis,
+    // [low, high]: span of the barrier across the query axis
+    void insert(oa::oaCoord coord, oa::oaCoord low, oa::oaCoord high, \
+            oa::oaInt4 netID, const line_t &seg);
+    // inserts until endBulk() are only buffered: endBulk() sorts them
+    // once and merges them into the levels in one build
+    void beginBulk() { _bulk = true; }
+    void endBulk();
+    void clear();
+    // remove all barriers of a net
+    void eraseNet(oa::oaInt4 netID);
+    size_t size() const;
+
+    // find the barrier with the largest coord < pos (findBefore) or the
+    // smallest coord > pos (findAfter) such that
+    // low - margin < across < high + margin and its net is not excludeNet.
+    // Among barriers of the same coord, the later inserted one is nearer
+    // for findBefore and the earlier inserted one for findAfter.
+    bool findBefore(oa::oaCoord pos, oa::oaCoord across, oa::oaInt4 excludeNet, \
+            line_t &seg) const;
+    bool findAfter(oa::oaCoord pos, oa::oaCoord across, oa::oaInt4 excludeNet, \
+            line_t &seg) const;
+    // findBefore and findAfter in one pass, before/after are left
+    // untouched if there is no such barrier
+    void findAround(oa::oaCoord pos, oa::oaCoord across, oa::oaInt4 excludeNet, \
+            line_t &before, line_t &after) const;
+
+    // nearest barrier coord strictly after (dir > 0) or before (dir < 0) pos
+    bool nextCoord(oa::oaCoord pos, int dir, oa::oaCoord &next) const;
+    // nearest coordinate strictly after/before across at which a point
+    // enters or leaves the span of a barrier widened by the margin
+    bool nextSpanBound(oa::oaCoord across, int dir, oa::oaCoord &next) const;
+private:
+    // Columns_t: barriers in structure-of-arrays layout, so that the span
+    // compares of a scan run over contiguous coordinates
+    struct Columns_t {
+        std::vector<oa::oaCoord> coord;
+        std::vector<oa::oaCoord> low;
+        std::vector<oa::oaCoord> high;
+        std::vector<oa::oaInt4> netID;
+        std::vector<oa::oaUInt4> seq;
+        std::vector<line_t> seg;
+
+        size_t size() const { return coord.size(); }
+        bool empty() const { return coord.empty(); }
+        void clear();
+        void reserve(size_t n);
+        void append(const Columns_t &from, size_t i);
+        void merge(const Columns_t &lhs, const Columns_t &rhs);
+        void swap(Columns_t &other);
+    };
+
+    // Level_t: barriers sorted by (coord, seq) and the stabbing tree over
+    // their widened spans, a bottom-up segment tree: leaf i is node
+    // leaves + i, the slot [bounds[i], bounds[i + 1]). The entries of node
+    // n are entries[first[n]] .. entries[first[n + 1] - 1], ascending
+    // positions in sorted. Entries of one net next to each other form a
+    // run: runs holds the index of the last entry of the run at its first
+    // entry and the index of the first entry at the others.
+    struct Level_t {
+        Level_t() : sorted(), sortedLows(), sortedHighs(), bounds(), leaves(0), \
+            first(), entries(), runs() {}
+
+        Columns_t sorted;
+        // span bounds of sorted, each sorted on its own
+        std::vector<oa::oaCoord> sortedLows;
+        std::vector<oa::oaCoord> sortedHighs;
+        std::vector<oa::oaCoord> bounds;
+        size_t leaves;
+        std::vector<oa::oaUInt4> first;
+        std::vector<oa::oaUInt4> entries;
+        std::vector<oa::oaUInt4> runs;
+
+        // first entry of the run of entry k
+        long runFirst(long k) const { return (runs[k] < k) ? runs[k] : k; }
+        void clear();
+        void build(Columns_t &barriers, oa::oaInt4 margin);
+        // nearest positions below limitBefore / at or above limitAfter
+        // covering across, best* are only replaced by nearer positions
+        void stab(oa::oaCoord across, oa::oaInt4 excludeNet, size_t limitBefore, \
+                size_t limitAfter, long &bestBefore, long &bestAfter) const;
+    };
+
+    // Hit_t: the nearest barrier a query found so far
+    struct Hit_t {
+        Hit_t() : coord(0), seq(0), seg(NULL) {}
+        oa::oaCoord coord;
+        oa::oaUInt4 seq;
+        const line_t *seg;
+    };
+
+    void find(oa::oaCoord pos, oa::oaCoord across, oa::oaInt4 excludeNet, \
+            bool wantBefore, bool wantAfter, Hit_t &before, Hit_t &after) const;
+    // merge the pending barriers into the levels
+    void flush();
+    // rebuild all barriers but those of skipNet into one level
+    void rebuildAll(oa::oaInt4 skipNet);
+
+    // _levels: level k holds at most PENDING_MAX << k barriers, shared
+    // with the copies of this index
+    // _pending: barriers inserted since the last flush, in insertion order
+    // _bulk: between beginBulk() and endBulk()
+    std::vector<CowPtr_t<Level_t> > _levels;
+    Columns_t _pending;
+    oa::oaUInt4 _seq;
+    oa::oaInt4 _margin;
+    bool _bulk;
+};
+
+#endif
@@ -0,0 +1,16 @@
+// The class CancelToken_t asks a search running on another thread to give
+// up: the owner calls cancel(), the search polls cancelled() and returns
+// as if it had found nothing. The flag is read and written atomically.
+#ifndef CANCELTOKEN_H_
+#define CANCELTOKEN_H_
+
+class CancelToken_t {
+public:
+    CancelToken_t() : _cancelled(0) {}
+    void cancel() { __sync_lock_test_and_set(&_cancelled, 1); }
+    bool cancelled() const { return __sync_fetch_and_add(&_cancelled, 0) != 0; }
+private:
+    mutable int _cancelled;
+};
+
+#endif
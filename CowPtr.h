@@ -0,0 +1,64 @@
+// The class CowPtr_t shares one value between its copies until one of
+// them changes it: copying is O(1), unique() copies the value only while
+// it is shared. Copies may be used on different threads (the portfolio
+// workers), so the reference count is updated atomically.
+#ifndef COWPTR_H_
+#define COWPTR_H_
+
+template <class T>
+class CowPtr_t {
+public:
+    CowPtr_t() : _block(new Block_t()) {}
+    CowPtr_t(const CowPtr_t &other) : _block(other._block) { acquire(_block); }
+    ~CowPtr_t() { release(_block); }
+    CowPtr_t &operator=(const CowPtr_t &other) {
+        acquire(other._block);
+        release(_block);
+        _block = other._block;
+        return *this;
+    }
+
+    const T &operator*() const { return _block->value; }
+    const T *operator->() const { return &_block->value; }
+    // true while another copy reads the value
+    bool shared() const { return shared(_block); }
+    // the value, made this copy's own first
+    T &unique() {
+        if (shared(_block)) {
+            Block_t *copy = new Block_t(_block->value);
+            release(_block);
+            _block = copy;
+        }
+        return _block->value;
+    }
+    // the value, made this copy's own without copying it: a shared value
+    // is replaced by a default constructed one
+    T &reset() {
+        if (shared(_block)) {
+            release(_block);
+            _block = new Block_t();
+        }
+        return _block->value;
+    }
+private:
+    struct Block_t {
+        Block_t() : value(), refs(1) {}
+        explicit Block_t(const T &from) : value(from), refs(1) {}
+        T value;
+        int refs;
+    };
+
+    // an atomic read: a count of 1 left by another copy's release must
+    // also order that copy's reads before the changes of this one
+    static bool shared(Block_t *block) { return __sync_fetch_and_add(&block->refs, 0) != 1; }
+    static void acquire(Block_t *block) { __sync_add_and_fetch(&block->refs, 1); }
+    static void release(Block_t *block) {
+        if (__sync_sub_and_fetch(&block->refs, 1) == 0) {
+            delete block;
+        }
+    }
+
+    Block_t *_block;
+};
+
+#endif
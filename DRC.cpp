@@ -1,5 +1,4 @@
 #include <iostream>
-#include <string>
 #include "DRC.h"
 
 using namespace std;
@@ -7,50 +6,31 @@ using namespace oa;
 
 DRC_t::DRC_t(ifstream &file)
 {
-    file.clear();
-    file.seekg(0);
-    string line;
-    getline(file, line);
-    if (file.good()) {
+    MappedFile_t text(file, "design rule file");
+    parse(text);
+}
+
+DRC_t::DRC_t(const char *fileName)
+{
+    MappedFile_t text(fileName);
+    parse(text);
+}
+
+void
+DRC_t::parse(const MappedFile_t &file)
+{
+    TextScanner_t scanner(file);
+    setMetalWidth(scanner.integer("metal width"));
+    setMetalSpacing(scanner.integer("metal spacing"));
+    setViaExtension(scanner.integer("via extension"));
+    setMetalArea(scanner.integer("metal area"));
+    setViaWidth(scanner.integer("via width"));
+    setViaHeight(scanner.integer("via height"));
+    scanner.endLine();
 #ifdef DEBUG
-        cout << line << endl;
+    cout << _metalWidth << " " << _metalSpacing << " " << _viaExtension << " ";
+    cout << _metalArea << " " << _viaWidth << " " << _viaHeight << endl;
 #endif
-        istringstream ss(line);
-        oaInt4 value;
-        int i;
-        for (i = 0; i < 6 && (ss >> value); ++i) {
-            switch (i) {
-            case 0:
-                setMetalWidth(value);
-                break;
-            case 1:
-                setMetalSpacing(value);
-                break;
-            case 2:
-                setViaExtension(value);
-                break;
-            case 3:
-                setMetalArea(value);
-                break;
-            case 4:
-                setViaWidth(value);
-                break;
-            case 5:
-                setViaHeight(value);
-                break;
-            default:
-                cerr << "Error in switch..." << endl;
-                exit(1);
-            } 
-        }
-        if (i != 6) {
-            cerr << "Invalid design rule format: " << line << endl;
-            exit(1);
-        }
-    } else {
-        cerr << "Cannot read design rule file." << endl;
-        exit(1);
-    }
 }
 
 void
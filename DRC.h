@@ -1,11 +1,14 @@
 #ifndef DRC_H_
 #define DRC_H_
 #include <fstream>
-#include "oaDesignDB.h"
+#include "Geometry.h"
+#include "TextParser.h"
 
 class DRC_t {
 public:
+    // both throw a ParseError_t on malformed input
     DRC_t(std::ifstream &file);
+    explicit DRC_t(const char *fileName);
     oa::oaInt4 metalWidth() const { return _metalWidth; }
     oa::oaInt4 metalSpacing() const { return _metalSpacing; }
     oa::oaInt4 viaExtension() const { return _viaExtension; }
@@ -15,6 +18,9 @@ public:
     oa::oaInt4 minimumStep() const { return _metalArea / _metalWidth; }
     void restoreToMin();
 private:
+    // the first line holds metal width, metal spacing, via extension,
+    // metal area, via width and via height
+    void parse(const MappedFile_t &file);
     void setMetalWidth(oa::oaInt4 width) { _metalWidth = 10 * width; }
     void setMetalSpacing(oa::oaInt4 space) { _metalSpacing = 10 * space; }
     void setViaExtension(oa::oaInt4 extension) { _viaExtension = 10 * extension; }
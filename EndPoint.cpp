@@ -1,13 +1,15 @@
 #include <iostream>
 #include <map>
-#include "oaDesignDB.h"
+#include <limits>
+#include <algorithm>
+#include "Geometry.h"
 #include "EndPoint.h"
 
 using namespace oa;
 using namespace std;
 
 EndPoint_t::EndPoint_t(oaCoord x, oaCoord y, oaInt4 id)
-    : _escapePoints(), _hlines(), _vlines(), _netID(id)
+    : _escapePoints(), _hlines(), _vlines(), _hbounds(), _vbounds(), _netID(id)
 {
     _orient = BOTH;
     _noEscape = false;
@@ -17,44 +19,89 @@ EndPoint_t::EndPoint_t(oaCoord x, oaCoord y, oaInt4 id)
 void
 EndPoint_t::addHline(const line_t &newline)
 {
-    LineSet_t::iterator it = _hlines.find(newline.first.y());
-    if (it != _hlines.end()) {
-#ifdef DEBUG
-        cerr << "Should not enter here!" << endl;
-#endif
-        // replace with a longer hline
-        if ((it->second).first.x() > newline.first.x()) {
-            (it->second).first.x() = newline.first.x();
-        }
-        if ((it->second).second.x() < newline.second.x()) {
-            (it->second).second.x() = newline.second.x();
-        }
-    }
-    else {
-        _hlines.insert(LineSet_t::value_type(newline.first.y(), newline));
-    }
+    addLine(_hlines, _hbounds, newline, true);
 }
 
 
 void
 EndPoint_t::addVline(const line_t &newline)
 {
-    LineSet_t::iterator it = _vlines.find(newline.first.x());
-    if (it != _vlines.end()) {
-#ifdef DEBUG
-        cerr << "Should not enter here!" << endl;
-#endif
-        // replace with a longer vline
-        if ((it->second).first.y() > newline.first.y()) {
-            (it->second).first.y() = newline.first.y();
+    addLine(_vlines, _vbounds, newline, false);
+}
+
+void
+EndPoint_t::trackLines(const LineSet_t &lines, oaCoord track, \
+        LineSet_t::const_iterator &first, LineSet_t::const_iterator &last)
+{
+    first = lines.lower_bound(LineKey_t(track, numeric_limits<oaCoord>::min()));
+    last = lines.upper_bound(LineKey_t(track, numeric_limits<oaCoord>::max()));
+}
+
+static void
+insertBound(vector<oaCoord> &bounds, oaCoord bound)
+{
+    bounds.insert(upper_bound(bounds.begin(), bounds.end(), bound), bound);
+}
+
+static void
+eraseBound(vector<oaCoord> &bounds, oaCoord bound)
+{
+    bounds.erase(lower_bound(bounds.begin(), bounds.end(), bound));
+}
+
+// Two escape lines on one track are separate when an obstacle lies
+// between them: replacing them by one longer line would let the corner
+// points and the intersections run through the obstacle.
+void
+EndPoint_t::addLine(LineSet_t &lines, BoundSet_t &bounds, const line_t &newline, \
+        bool horizontal)
+{
+    oaCoord track = horizontal ? newline.first.y() : newline.first.x();
+    oaCoord low = horizontal ? min(newline.first.x(), newline.second.x()) : \
+        min(newline.first.y(), newline.second.y());
+    oaCoord high = horizontal ? max(newline.first.x(), newline.second.x()) : \
+        max(newline.first.y(), newline.second.y());
+    LineSet_t::iterator it = lines.lower_bound(LineKey_t(track, numeric_limits<oaCoord>::min()));
+    while (it != lines.end() && it->first.first == track) {
+        oaCoord lineLow = it->first.second;
+        oaCoord lineHigh = horizontal ? it->second.second.x() : it->second.second.y();
+        if (lineLow <= high && low <= lineHigh) {
+            low = min(low, lineLow);
+            high = max(high, lineHigh);
+            eraseBound(bounds, lineLow);
+            eraseBound(bounds, lineHigh);
+            it = lines.erase(it);
         }
-        if ((it->second).second.y() < newline.second.y()) {
-            (it->second).second.y() = newline.second.y();
+        else {
+            ++it;
         }
     }
-    else {
-        _vlines.insert(LineSet_t::value_type(newline.first.x(), newline));
+    line_t merged = horizontal ? line_t(oaPoint(low, track), oaPoint(high, track)) : \
+        line_t(oaPoint(track, low), oaPoint(track, high));
+    lines.insert(LineSet_t::value_type(LineKey_t(track, low), merged));
+    insertBound(bounds, low);
+    insertBound(bounds, high);
+}
+
+bool
+EndPoint_t::lineThrough(const LineSet_t &lines, oaCoord track, bool horizontal, \
+        const oaPoint &a, const oaPoint &b)
+{
+    if ((horizontal ? a.y() : a.x()) != track || (horizontal ? b.y() : b.x()) != track) {
+        return false;
+    }
+    oaCoord aPos = horizontal ? a.x() : a.y();
+    oaCoord bPos = horizontal ? b.x() : b.y();
+    LineSet_t::const_iterator lineIter, last;
+    trackLines(lines, track, lineIter, last);
+    for (; lineIter != last; ++lineIter) {
+        oaCoord low = lineIter->first.second;
+        oaCoord high = horizontal ? lineIter->second.second.x() : lineIter->second.second.y();
+        if (low <= min(aPos, bPos) && max(aPos, bPos) <= high) {
+            return true;
+        }
     }
+    return false;
 }
 
 bool
@@ -69,8 +116,8 @@ EndPoint_t::isIntersect(const line_t &line, oaPoint &intersectionPoint) const
         // we find a intersection
         
         LineSet_t::const_iterator lineIter, low, high;
-        low = _hlines.lower_bound(line.first.y());
-        high = _hlines.upper_bound(line.second.y());
+        low = _hlines.lower_bound(LineKey_t(line.first.y(), numeric_limits<oaCoord>::min()));
+        high = _hlines.upper_bound(LineKey_t(line.second.y(), numeric_limits<oaCoord>::max()));
         oaCoord xpos = line.first.x();
         for (lineIter = low; lineIter != high; ++lineIter) {
             if (lineIter->second.first.x() <= xpos && \
@@ -92,8 +139,8 @@ EndPoint_t::isIntersect(const line_t &line, oaPoint &intersectionPoint) const
         // we find a intersection
 
         LineSet_t::const_iterator lineIter, low, high;
-        low = _vlines.lower_bound(line.first.x());
-        high = _vlines.upper_bound(line.second.x());
+        low = _vlines.lower_bound(LineKey_t(line.first.x(), numeric_limits<oaCoord>::min()));
+        high = _vlines.upper_bound(LineKey_t(line.second.x(), numeric_limits<oaCoord>::max()));
         oaCoord ypos = line.first.y();
         for (lineIter = low; lineIter != high; ++lineIter) {
             if (lineIter->second.first.y() <= ypos && \
@@ -118,32 +165,20 @@ EndPoint_t::isIntersect(const line_t &line, oaPoint &intersectionPoint) const
 bool
 EndPoint_t::onEscapeLines(const oaPoint &point, Orient_t orient) const
 {
-    LineSet_t::const_iterator lineIter;
-
     switch (orient) {
     case BOTH:
         // fall through
     case HORIZONTAL:
-        lineIter = _hlines.find(point.y());
-        if (lineIter != _hlines.end()) {
-            // check if point is lies on this line
-            if ((lineIter->second.first.x() <= point.x()) && \
-                    (point.x() <= lineIter->second.second.x())) {
-                return true;
-            }
+        if (lineThrough(_hlines, point.y(), true, point, point)) {
+            return true;
         }
         if (HORIZONTAL == orient) {
             // let case BOTH pass through
             break;
         }
     case VERTICAL:
-        lineIter = _vlines.find(point.x());
-        if (lineIter != _vlines.end()) {
-            // check if point lies on this line
-            if ((lineIter->second.first.y() <= point.y()) && \
-                    (point.y() <= lineIter->second.second.y())) {
-                return true;
-            }
+        if (lineThrough(_vlines, point.x(), false, point, point)) {
+            return true;
         }
         break;
     default:
@@ -155,7 +190,45 @@ EndPoint_t::onEscapeLines(const oaPoint &point, Orient_t orient) const
 }
 
 
-void
+bool
+EndPoint_t::nextLineBound(oaCoord pos, Orient_t orient, int dir, oaCoord &next) const
+{
+    // moving along y (VERTICAL), hlines lie at their track and vlines
+    // start and end at their bounds; the other way round along x
+    const LineSet_t &across = (orient == VERTICAL) ? _hlines : _vlines;
+    const BoundSet_t &bounds = (orient == VERTICAL) ? _vbounds : _hbounds;
+    bool found = false;
+
+    if (dir > 0) {
+        LineSet_t::const_iterator lineIter = across.upper_bound( \
+                LineKey_t(pos, numeric_limits<oaCoord>::max()));
+        if (lineIter != across.end()) {
+            next = lineIter->first.first;
+            found = true;
+        }
+        BoundSet_t::const_iterator it = upper_bound(bounds.begin(), bounds.end(), pos);
+        if (it != bounds.end() && (!found || *it < next)) {
+            next = *it;
+            found = true;
+        }
+    }
+    else {
+        LineSet_t::const_iterator lineIter = across.lower_bound( \
+                LineKey_t(pos, numeric_limits<oaCoord>::min()));
+        if (lineIter != across.begin()) {
+            next = (--lineIter)->first.first;
+            found = true;
+        }
+        BoundSet_t::const_iterator it = lower_bound(bounds.begin(), bounds.end(), pos);
+        if (it != bounds.begin() && (!found || *(--it) > next)) {
+            next = *it;
+            found = true;
+        }
+    }
+    return found;
+}
+
+bool
 EndPoint_t::getCornerPoints(const oaPoint &intersectionPoint)
 {
     // find the escapePoint that are on the same line with intersectionPoint
@@ -166,8 +239,7 @@ EndPoint_t::getCornerPoints(const oaPoint &intersectionPoint)
     for (PointSet_t::iterator it = _escapePoints.begin(); it != _escapePoints.end(); ++it) {
         if (it->x() == intersectionPoint.x()) {
             // search vertical lines
-            LineSet_t::iterator lineIter = _vlines.find(it->x());
-            if (lineIter != _vlines.end() && lineIter->second.contains(*it) && lineIter->second.contains(intersectionPoint)) {
+            if (lineThrough(_vlines, it->x(), false, *it, intersectionPoint)) {
                 last = it;
                 // search horizontal lines in finding next corner point
                 lineOrient = HORIZONTAL;
@@ -180,8 +252,7 @@ EndPoint_t::getCornerPoints(const oaPoint &intersectionPoint)
             // Consider the case that *it is the same point as intersectionPoint
             
             // search horizontal lines
-            LineSet_t::iterator lineIter = _hlines.find(it->y());
-            if (lineIter != _hlines.end() && lineIter->second.contains(*it) && lineIter->second.contains(intersectionPoint)) {
+            if (lineThrough(_hlines, it->y(), true, *it, intersectionPoint)) {
                 last = it;
                 // search vertical lines in finding next corner point
                 lineOrient = VERTICAL;
@@ -192,15 +263,16 @@ EndPoint_t::getCornerPoints(const oaPoint &intersectionPoint)
         }
     }
     if (last == _escapePoints.end()) {
-        cerr << "Internal error in getCornerPoints." << endl;
-        exit(1);
-    }  
+        // no escape line through the intersection point, the connection
+        // fails instead of the whole run
+        return false;
+    }
     while (last != _escapePoints.begin()) {
+        PointSet_t::iterator previous = last;
         if (lineOrient == VERTICAL) {
             for (PointSet_t::iterator it = _escapePoints.begin(); it != last; ++it) {
                 // check if *it and reference are on the same line
-                LineSet_t::iterator lineIter = _vlines.find(it->x());
-                if (lineIter != _vlines.end() && lineIter->second.contains(*it) && lineIter->second.contains(reference)) {
+                if (lineThrough(_vlines, it->x(), false, *it, reference)) {
                     last = it;
                     lineOrient = HORIZONTAL;
                     reference = *it;
@@ -212,8 +284,7 @@ EndPoint_t::getCornerPoints(const oaPoint &intersectionPoint)
         else {
             for (PointSet_t::iterator it = _escapePoints.begin(); it != last; ++it) {
                 // check if *it and reference are on the same line
-                LineSet_t::iterator lineIter = _hlines.find(it->y());
-                if (lineIter != _hlines.end() && lineIter->second.contains(*it) && lineIter->second.contains(reference)) {
+                if (lineThrough(_hlines, it->y(), true, *it, reference)) {
                     last = it;
                     lineOrient = VERTICAL;
                     reference = *it;
@@ -222,5 +293,10 @@ EndPoint_t::getCornerPoints(const oaPoint &intersectionPoint)
                 }
             } 
         }
+        if (last == previous) {
+            // no earlier escape point on the line of reference
+            return false;
+        }
     }
+    return true;
 }
@@ -2,8 +2,10 @@
 #ifndef ENDPOINT_H_
 #define ENDPOINT_H_
 
-#include "oaDesignDB.h"
+#include <vector>
+#include "Geometry.h"
 #include "RouterType.h"
+#include "FlatMap.h"
 
 class EndPoint_t {
 public:
@@ -19,7 +21,8 @@ public:
     void removeEscapePoint() { _escapePoints.pop_back(); }
 
     // we get _cornerPoints only after an intersection point is found.
-    void getCornerPoints(const oa::oaPoint &intersectionPoint);
+    // false if the escape lines do not lead back to the object point
+    bool getCornerPoints(const oa::oaPoint &intersectionPoint);
     // cornerPoints() can only be called after an 
     // intersectionPoint is found!
     PointSet_t &cornerPoints() { return _cornerPoints; }
@@ -35,14 +38,36 @@ public:
 
     bool isIntersect(const line_t &line, oa::oaPoint &intersectionPoint) const;
     bool onEscapeLines(const oa::oaPoint &point, Orient_t orient) const;
+    // nearest coordinate strictly after (dir > 0) or before (dir < 0) pos
+    // along orient at which one of the escape lines starts, ends or lies
+    bool nextLineBound(oa::oaCoord pos, Orient_t orient, int dir, \
+            oa::oaCoord &next) const;
     oa::oaInt4 netID() const { return _netID; }
 private:
-    typedef std::map<oa::oaCoord, line_t> LineSet_t;
+    // LineSet_t: escape lines keyed by (track, start). A track can hold
+    // several lines; lines that overlap or touch are merged, disjoint ones
+    // are kept apart so that no line spans the obstacle between them.
+    typedef std::pair<oa::oaCoord, oa::oaCoord> LineKey_t;
+    typedef FlatMap_t<LineKey_t, line_t> LineSet_t;
+    // BoundSet_t: the start and end of every line of a LineSet_t along its
+    // track, sorted, for nextLineBound
+    typedef std::vector<oa::oaCoord> BoundSet_t;
+
+    // lines of lines on track: [first, last)
+    static void trackLines(const LineSet_t &lines, oa::oaCoord track, \
+            LineSet_t::const_iterator &first, LineSet_t::const_iterator &last);
+    static void addLine(LineSet_t &lines, BoundSet_t &bounds, const line_t &newline, \
+            bool horizontal);
+    // a line of lines on track that holds both a and b
+    static bool lineThrough(const LineSet_t &lines, oa::oaCoord track, bool horizontal, \
+            const oa::oaPoint &a, const oa::oaPoint &b);
 
     Orient_t _orient;
     PointSet_t _escapePoints;
     LineSet_t _hlines;
     LineSet_t _vlines; 
+    BoundSet_t _hbounds;
+    BoundSet_t _vbounds;
     bool _noEscape;
     oa::oaInt4 _netID;
     PointSet_t _cornerPoints;
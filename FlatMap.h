@@ -0,0 +1,174 @@
+// FlatMultimap_t and FlatMap_t: sorted contiguous replacements for the
+// std::multimap / std::map containers used by the line-probing algorithm.
+// Elements live in one vector instead of one heap node each, lookups are
+// binary searches over contiguous memory.
+#ifndef FLATMAP_H_
+#define FLATMAP_H_
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <iterator>
+#include "CowPtr.h"
+
+// FlatMultimap_t: insertions are appended to an unsorted tail and merged
+// into the sorted part on the next lookup, so a batch of insertions costs
+// one sort. Equal keys keep their insertion order, as in std::multimap.
+// The sorted part is shared between copies until one of them changes it
+// (see CowPtr.h), so elements are read-only through iterators.
+template <class Key, class T>
+class FlatMultimap_t {
+public:
+    typedef std::pair<Key, T> value_type;
+    typedef typename std::vector<value_type>::const_iterator const_iterator;
+    typedef const_iterator iterator;
+
+    FlatMultimap_t() : _sorted(), _tail() {}
+
+    void insert(const value_type &value) { _tail.push_back(value); }
+    void clear() { _sorted.reset().clear(); _tail.clear(); }
+    size_t size() const { return _sorted->size() + _tail.size(); }
+    bool empty() const { return size() == 0; }
+
+    const_iterator begin() const { rebuild(); return _sorted->begin(); }
+    const_iterator end() const { rebuild(); return _sorted->end(); }
+
+    const_iterator lower_bound(const Key &key) const {
+        rebuild();
+        return std::lower_bound(_sorted->begin(), _sorted->end(), key, KeyLess());
+    }
+    const_iterator upper_bound(const Key &key) const {
+        rebuild();
+        return std::upper_bound(_sorted->begin(), _sorted->end(), key, KeyLess());
+    }
+    std::pair<const_iterator, const_iterator> equal_range(const Key &key) const {
+        rebuild();
+        return std::equal_range(_sorted->begin(), _sorted->end(), key, KeyLess());
+    }
+    // remove all elements for which pred(value) holds
+    template <class Pred>
+    void eraseIf(Pred pred) {
+        rebuild();
+        const_iterator first = std::find_if(_sorted->begin(), _sorted->end(), pred);
+        if (first == _sorted->end()) {
+            return;
+        }
+        if (_sorted.shared()) {
+            // copy only what is kept
+            std::vector<value_type> kept(_sorted->begin(), first);
+            std::remove_copy_if(first, _sorted->end(), std::back_inserter(kept), pred);
+            _sorted.reset().swap(kept);
+            return;
+        }
+        std::vector<value_type> &data = _sorted.unique();
+        data.erase(std::remove_if(data.begin(), data.end(), pred), data.end());
+    }
+private:
+    struct KeyLess {
+        bool operator()(const value_type &lhs, const value_type &rhs) const {
+            return lhs.first < rhs.first;
+        }
+        bool operator()(const value_type &lhs, const Key &rhs) const {
+            return lhs.first < rhs;
+        }
+        bool operator()(const Key &lhs, const value_type &rhs) const {
+            return lhs < rhs.first;
+        }
+    };
+
+    // merge the tail into the sorted part
+    void rebuild() const {
+        if (_tail.empty()) {
+            return;
+        }
+        std::stable_sort(_tail.begin(), _tail.end(), KeyLess());
+        if (_sorted->empty()) {
+            // a first batch, e.g. the obstacles of a new router, is taken over
+            _sorted.reset().swap(_tail);
+            return;
+        }
+        if (_sorted.shared()) {
+            // another copy (a savepoint) keeps the old sorted part: merge
+            // into a new one instead of copying it and merging in place
+            std::vector<value_type> merged;
+            merged.reserve(_sorted->size() + _tail.size());
+            std::merge(_sorted->begin(), _sorted->end(), _tail.begin(), _tail.end(), \
+                    std::back_inserter(merged), KeyLess());
+            _sorted.reset().swap(merged);
+            _tail.clear();
+            return;
+        }
+        std::vector<value_type> &data = _sorted.unique();
+        size_t mid = data.size();
+        data.insert(data.end(), _tail.begin(), _tail.end());
+        std::inplace_merge(data.begin(), data.begin() + mid, data.end(), KeyLess());
+        _tail.clear();
+    }
+
+    // sorting is not an observable change, lookups on const sets may do it
+    mutable CowPtr_t<std::vector<value_type> > _sorted;
+    mutable std::vector<value_type> _tail;
+};
+
+// FlatMap_t: unique keys kept sorted on every insertion, meant for the
+// small per-EndPoint line sets.
+template <class Key, class T>
+class FlatMap_t {
+public:
+    typedef std::pair<Key, T> value_type;
+    typedef typename std::vector<value_type>::iterator iterator;
+    typedef typename std::vector<value_type>::const_iterator const_iterator;
+
+    FlatMap_t() : _data() {}
+
+    size_t size() const { return _data.size(); }
+    bool empty() const { return _data.empty(); }
+    void clear() { _data.clear(); }
+
+    iterator begin() { return _data.begin(); }
+    iterator end() { return _data.end(); }
+    const_iterator begin() const { return _data.begin(); }
+    const_iterator end() const { return _data.end(); }
+
+    std::pair<iterator, bool> insert(const value_type &value) {
+        iterator it = lower_bound(value.first);
+        if (it != _data.end() && it->first == value.first) {
+            return std::make_pair(it, false);
+        }
+        return std::make_pair(_data.insert(it, value), true);
+    }
+    iterator find(const Key &key) {
+        iterator it = lower_bound(key);
+        return (it != _data.end() && it->first == key) ? it : _data.end();
+    }
+    const_iterator find(const Key &key) const {
+        const_iterator it = lower_bound(key);
+        return (it != _data.end() && it->first == key) ? it : _data.end();
+    }
+    iterator lower_bound(const Key &key) {
+        return std::lower_bound(_data.begin(), _data.end(), key, KeyLess());
+    }
+    const_iterator lower_bound(const Key &key) const {
+        return std::lower_bound(_data.begin(), _data.end(), key, KeyLess());
+    }
+    iterator upper_bound(const Key &key) {
+        return std::upper_bound(_data.begin(), _data.end(), key, KeyLess());
+    }
+    const_iterator upper_bound(const Key &key) const {
+        return std::upper_bound(_data.begin(), _data.end(), key, KeyLess());
+    }
+    iterator erase(iterator it) { return _data.erase(it); }
+private:
+    struct KeyLess {
+        bool operator()(const value_type &lhs, const Key &rhs) const {
+            return lhs.first < rhs;
+        }
+        bool operator()(const Key &lhs, const value_type &rhs) const {
+            return lhs < rhs.first;
+        }
+    };
+
+    std::vector<value_type> _data;
+};
+
+#endif
@@ -0,0 +1,135 @@
+// Geometry.h: the OpenAccess value types used by the routing core.
+// Normally they come from the OA headers. With ROUTER_NO_OA defined, the
+// core (Router_t, EndPoint_t, DRC_t and the containers they use) is built
+// against the plain value classes below instead, so it compiles and links
+// without an OA installation. Only the members the core uses are provided,
+// with the same names and semantics as their OA counterparts.
+#ifndef GEOMETRY_H_
+#define GEOMETRY_H_
+
+#ifndef ROUTER_NO_OA
+#include "oaDesignDB.h"
+#else
+#include <string>
+#include <ostream>
+
+namespace oa {
+
+typedef int oaInt4;
+typedef unsigned int oaUInt4;
+typedef long long oaInt8;
+typedef unsigned long long oaUInt8;
+typedef int oaCoord;
+typedef unsigned int oaLayerNum;
+typedef bool oaBoolean;
+
+class oaPoint {
+public:
+    oaPoint() : _x(0), _y(0) {}
+    oaPoint(oaCoord xVal, oaCoord yVal) : _x(xVal), _y(yVal) {}
+
+    oaCoord &x() { return _x; }
+    oaCoord &y() { return _y; }
+    oaCoord x() const { return _x; }
+    oaCoord y() const { return _y; }
+    void set(oaCoord xVal, oaCoord yVal) { _x = xVal; _y = yVal; }
+
+    oaPoint &operator+=(const oaPoint &point) {
+        _x += point._x;
+        _y += point._y;
+        return *this;
+    }
+    oaPoint &operator-=(const oaPoint &point) {
+        _x -= point._x;
+        _y -= point._y;
+        return *this;
+    }
+    bool operator==(const oaPoint &point) const {
+        return _x == point._x && _y == point._y;
+    }
+    bool operator!=(const oaPoint &point) const { return !(*this == point); }
+private:
+    oaCoord _x;
+    oaCoord _y;
+};
+
+class oaBox {
+public:
+    oaBox() : _left(0), _bottom(0), _right(0), _top(0) {}
+    oaBox(oaCoord left, oaCoord bottom, oaCoord right, oaCoord top)
+        : _left(left), _bottom(bottom), _right(right), _top(top) {}
+    oaBox(const oaPoint &lowerLeft, const oaPoint &upperRight)
+        : _left(lowerLeft.x()), _bottom(lowerLeft.y()), \
+          _right(upperRight.x()), _top(upperRight.y()) {}
+
+    oaCoord &left() { return _left; }
+    oaCoord &bottom() { return _bottom; }
+    oaCoord &right() { return _right; }
+    oaCoord &top() { return _top; }
+    oaCoord left() const { return _left; }
+    oaCoord bottom() const { return _bottom; }
+    oaCoord right() const { return _right; }
+    oaCoord top() const { return _top; }
+    oaPoint lowerLeft() const { return oaPoint(_left, _bottom); }
+    oaPoint upperRight() const { return oaPoint(_right, _top); }
+    oaCoord getWidth() const { return _right - _left; }
+    oaCoord getHeight() const { return _top - _bottom; }
+
+    void set(const oaPoint &lowerLeft, const oaPoint &upperRight) {
+        _left = lowerLeft.x();
+        _bottom = lowerLeft.y();
+        _right = upperRight.x();
+        _top = upperRight.y();
+    }
+    oaBoolean contains(const oaPoint &point, oaBoolean incEdge=true) const {
+        if (incEdge) {
+            return _left <= point.x() && point.x() <= _right && \
+                _bottom <= point.y() && point.y() <= _top;
+        }
+        return _left < point.x() && point.x() < _right && \
+            _bottom < point.y() && point.y() < _top;
+    }
+    oaBoolean overlaps(const oaBox &box, oaBoolean incEdge=true) const {
+        if (incEdge) {
+            return _left <= box._right && box._left <= _right && \
+                _bottom <= box._top && box._bottom <= _top;
+        }
+        return _left < box._right && box._left < _right && \
+            _bottom < box._top && box._bottom < _top;
+    }
+    bool operator==(const oaBox &box) const {
+        return _left == box._left && _bottom == box._bottom && \
+            _right == box._right && _top == box._top;
+    }
+    bool operator!=(const oaBox &box) const { return !(*this == box); }
+private:
+    oaCoord _left;
+    oaCoord _bottom;
+    oaCoord _right;
+    oaCoord _top;
+};
+
+class oaString {
+public:
+    oaString() : _str() {}
+    oaString(const char *str) : _str(str) {}
+
+    operator const char *() const { return _str.c_str(); }
+    oaUInt4 getLength() const { return _str.size(); }
+    bool operator==(const oaString &str) const { return _str == str._str; }
+    bool operator!=(const oaString &str) const { return _str != str._str; }
+private:
+    std::string _str;
+};
+
+inline std::ostream &
+operator<<(std::ostream &os, const oaString &str)
+{
+    return os << static_cast<const char *>(str);
+}
+
+}
+
+#endif
+
+#endif
@@ -0,0 +1,23 @@
+// The class LayoutBackend_t is the router's view of the layout database:
+// where the power rails are and where the routed shapes go. OaBackend_t
+// adapts an oaDesign, MemoryBackend_t keeps everything in memory so the
+// routing core runs without OpenAccess.
+#ifndef LAYOUTBACKEND_H_
+#define LAYOUTBACKEND_H_
+
+#include "Geometry.h"
+
+class LayoutBackend_t {
+public:
+    virtual ~LayoutBackend_t() {}
+    // get the bounding boxes of the VDD and VSS rails on metal1,
+    // returns false if the cell has no metal1 shapes
+    virtual bool rails(oa::oaBox &VDDBox, oa::oaBox &VSSBox) = 0;
+    // create the via1 and metal2 layers if they do not exist
+    virtual void createLayers() = 0;
+    virtual void createRect(oa::oaLayerNum layer, const oa::oaBox &box) = 0;
+    virtual void createLabel(oa::oaLayerNum layer, const oa::oaPoint &origin, \
+            const oa::oaString &label) = 0;
+};
+
+#endif
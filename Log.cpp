@@ -0,0 +1,117 @@
+#include <iostream>
+#include <cstdlib>
+#include <pthread.h>
+#include <time.h>
+#include "Log.h"
+
+using namespace std;
+
+// LogMessage_t: one queued line
+typedef struct LogMessage {
+    string text;
+    int level;
+    struct LogMessage *next;
+} LogMessage_t;
+
+// messages pushed by any thread, newest first
+static LogMessage_t *pending = NULL;
+static unsigned long pushed = 0;
+static unsigned long written = 0;
+static int stopping = 0;
+static pthread_t writer;
+static pthread_once_t writerOnce = PTHREAD_ONCE_INIT;
+
+static void
+sleepFor(long nanoseconds)
+{
+    struct timespec ts;
+    ts.tv_sec = 0;
+    ts.tv_nsec = nanoseconds;
+    nanosleep(&ts, NULL);
+}
+
+// write all pending messages in the order they were pushed, return
+// whether there were any
+static bool
+drain()
+{
+    LogMessage_t *message = __sync_lock_test_and_set(&pending, \
+            static_cast<LogMessage_t *>(NULL));
+    if (message == NULL) {
+        return false;
+    }
+    LogMessage_t *ordered = NULL;
+    while (message != NULL) {
+        LogMessage_t *next = message->next;
+        message->next = ordered;
+        ordered = message;
+        message = next;
+    }
+    unsigned long count = 0;
+    while (ordered != NULL) {
+        LogMessage_t *next = ordered->next;
+        (ordered->level >= ROUTER_LOG_WARN ? cerr : cout) << ordered->text << '\n';
+        delete ordered;
+        ordered = next;
+        ++count;
+    }
+    cout.flush();
+    cerr.flush();
+    __sync_fetch_and_add(&written, count);
+    return true;
+}
+
+static void *
+writeMessages(void *)
+{
+    while (true) {
+        if (!drain()) {
+            if (__sync_fetch_and_add(&stopping, 0)) {
+                break;
+            }
+            sleepFor(1000000);
+        }
+    }
+    return NULL;
+}
+
+// stop the writer at exit once the queue is empty
+static void
+stopWriter()
+{
+    __sync_lock_test_and_set(&stopping, 1);
+    pthread_join(writer, NULL);
+    drain();
+}
+
+static void
+startWriter()
+{
+    if (pthread_create(&writer, NULL, writeMessages, NULL) != 0) {
+        cerr << "Cannot create log thread." << endl;
+        exit(1);
+    }
+    atexit(stopWriter);
+}
+
+void
+logWrite(int level, const string &message)
+{
+    pthread_once(&writerOnce, startWriter);
+    LogMessage_t *node = new LogMessage_t;
+    node->text = message;
+    node->level = level;
+    do {
+        node->next = pending;
+    } while (!__sync_bool_compare_and_swap(&pending, node->next, node));
+    __sync_fetch_and_add(&pushed, 1);
+}
+
+void
+logFlush()
+{
+    unsigned long target = __sync_fetch_and_add(&pushed, 0);
+    while (__sync_fetch_and_add(&written, 0) < target) {
+        sleepFor(100000);
+    }
+}
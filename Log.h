@@ -0,0 +1,51 @@
+// Leveled logging. Messages below ROUTER_LOG_LEVEL are removed by the
+// preprocessor, their arguments are not evaluated. Enabled messages are
+// formatted by the caller and queued without a lock; a background thread
+// writes them to cout (warnings to cerr), so routing threads never wait for the terminal.
+#ifndef LOG_H_
+#define LOG_H_
+
+#include <string>
+#include <sstream>
+
+#define ROUTER_LOG_DEBUG 0
+#define ROUTER_LOG_INFO 1
+#define ROUTER_LOG_WARN 2
+#define ROUTER_LOG_NONE 3
+
+#ifndef ROUTER_LOG_LEVEL
+#define ROUTER_LOG_LEVEL ROUTER_LOG_INFO
+#endif
+
+// queue one line of output
+void logWrite(int level, const std::string &message);
+// wait until everything queued so far has been written
+void logFlush();
+
+// message is a chain of << operands, e.g. "net " << id
+#define ROUTER_LOG(level, message) \
+    do { \
+        std::ostringstream logStream; \
+        logStream << message; \
+        logWrite((level), logStream.str()); \
+    } while (0)
+
+#if ROUTER_LOG_LEVEL <= ROUTER_LOG_DEBUG
+#define DEBUG_LOG(message) ROUTER_LOG(ROUTER_LOG_DEBUG, message)
+#else
+#define DEBUG_LOG(message) do {} while (0)
+#endif
+
+#if ROUTER_LOG_LEVEL <= ROUTER_LOG_INFO
+#define INFO_LOG(message) ROUTER_LOG(ROUTER_LOG_INFO, message)
+#else
+#define INFO_LOG(message) do {} while (0)
+#endif
+
+#if ROUTER_LOG_LEVEL <= ROUTER_LOG_WARN
+#define WARN_LOG(message) ROUTER_LOG(ROUTER_LOG_WARN, message)
+#else
+#define WARN_LOG(message) do {} while (0)
+#endif
+
+#endif
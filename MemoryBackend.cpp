@@ -0,0 +1,32 @@
+#include "MemoryBackend.h"
+
+using namespace oa;
+using namespace std;
+
+bool
+MemoryBackend_t::rails(oaBox &VDDBox, oaBox &VSSBox)
+{
+    VDDBox = _VDDBox;
+    VSSBox = _VSSBox;
+    return true;
+}
+
+void
+MemoryBackend_t::createRect(oaLayerNum layer, const oaBox &box)
+{
+    Rect_t rect;
+    rect.layer = layer;
+    rect.box = box;
+    _rects.push_back(rect);
+}
+
+void
+MemoryBackend_t::createLabel(oaLayerNum layer, const oaPoint &origin, \
+        const oaString &label)
+{
+    Label_t text;
+    text.layer = layer;
+    text.origin = origin;
+    text.label = label;
+    _labels.push_back(text);
+}
@@ -0,0 +1,42 @@
+// The class MemoryBackend_t is a layout store without a database behind
+// it: the rails are given up front and created shapes are kept in vectors.
+#ifndef MEMORYBACKEND_H_
+#define MEMORYBACKEND_H_
+
+#include <vector>
+#include "Geometry.h"
+#include "LayoutBackend.h"
+
+class MemoryBackend_t : public LayoutBackend_t {
+public:
+    // Rect_t: a created rectangle, Label_t: a created label
+    typedef struct {
+        oa::oaLayerNum layer;
+        oa::oaBox box;
+    } Rect_t;
+    typedef struct {
+        oa::oaLayerNum layer;
+        oa::oaPoint origin;
+        oa::oaString label;
+    } Label_t;
+
+    MemoryBackend_t(const oa::oaBox &VDDBox, const oa::oaBox &VSSBox)
+        : _VDDBox(VDDBox), _VSSBox(VSSBox), _rects(), _labels() {}
+
+    bool rails(oa::oaBox &VDDBox, oa::oaBox &VSSBox);
+    void createLayers() {}
+    void createRect(oa::oaLayerNum layer, const oa::oaBox &box);
+    void createLabel(oa::oaLayerNum layer, const oa::oaPoint &origin, \
+            const oa::oaString &label);
+
+    const std::vector<Rect_t> &rects() const { return _rects; }
+    const std::vector<Label_t> &labels() const { return _labels; }
+    void clear() { _rects.clear(); _labels.clear(); }
+private:
+    oa::oaBox _VDDBox;
+    oa::oaBox _VSSBox;
+    std::vector<Rect_t> _rects;
+    std::vector<Label_t> _labels;
+};
+
+#endif
@@ -1,8 +1,9 @@
 #include <limits>
+#include <algorithm>
 #include <vector>
 #include <iostream>
 #include "Net.h"
-#include "oaDesignDB.h"
+#include "Geometry.h"
 
 using namespace std;
 using namespace oa;
@@ -11,11 +12,24 @@ Net_t::Net_t(const vector<oaPoint> &points, oaUInt4 id, NetType_t type, \
         oaString portName)
     : vector<oaPoint>(points), _id(id), _type(type), _portName(portName)
 {
-    vector<oaPoint>::const_iterator it;
+    setBBox();
+}
+
+Net_t::Net_t(vector<oaPoint>::const_iterator first, vector<oaPoint>::const_iterator last, \
+        oaUInt4 id, NetType_t type, oaString portName)
+    : vector<oaPoint>(first, last), _id(id), _type(type), _portName(portName)
+{
+    setBBox();
+}
+
+void
+Net_t::setBBox()
+{
+    const_iterator it;
     oaInt4 xmin, xmax, ymin, ymax;
     xmin = ymin = numeric_limits<oaInt4>::max(); 
     xmax = ymax = numeric_limits<oaInt4>::min();
-    for (it = points.begin(); it != points.end(); ++it) {
+    for (it = begin(); it != end(); ++it) {
         xmin = (it->x() < xmin) ? it->x() : xmin;
         xmax = (it->x() > xmax) ? it->x() : xmax; 
         ymin = (it->y() < ymin) ? it->y() : ymin;
@@ -29,3 +43,13 @@ Net_t::Net_t(const vector<oaPoint> &points, oaUInt4 id, NetType_t type, \
     cout << endl;
 #endif
 }
+
+void
+Net_t::swap(Net_t &net)
+{
+    vector<oaPoint>::swap(net);
+    std::swap(_id, net._id);
+    std::swap(_type, net._type);
+    std::swap(_portName, net._portName);
+    std::swap(_bbox, net._bbox);
+}
@@ -2,20 +2,28 @@
 #define NET_H_
 
 #include <vector>
-#include "oaDesignDB.h"
+#include "Geometry.h"
 #include "RouterType.h"
 
 class Net_t : public std::vector<oa::oaPoint> {
 public:
     Net_t(const std::vector<oa::oaPoint> &points, oa::oaUInt4 id, NetType_t type, \
             oa::oaString portName="");
+    // the contacts [first, last) of a pool shared by all nets of a file
+    Net_t(std::vector<oa::oaPoint>::const_iterator first, \
+            std::vector<oa::oaPoint>::const_iterator last, oa::oaUInt4 id, NetType_t type, \
+            oa::oaString portName="");
 
     oa::oaInt4 id() const { return _id; }
     NetType_t type() const { return _type; }
     oa::oaString portName() const { return _portName; }
+    const oa::oaBox &bbox() const { return _bbox; }
     oa::oaBoolean contains(const oa::oaPoint &point, \
             oa::oaBoolean incEdge=true) { return _bbox.contains(point, incEdge); }
+    // exchange contents with net without copying the contacts
+    void swap(Net_t &net);
 private:
+    void setBBox();
     oa::oaInt4 _id;
     NetType_t _type;
     oa::oaString _portName;
@@ -1,26 +1,99 @@
 #include <iostream>
 #include <string>
+#include <cstring>
 #include "NetSet.h"
 
 using namespace std;
 using namespace oa;
 
+// a parsed line, its contacts are pool[first, next net's first)
+typedef struct {
+    size_t first;
+    NetType_t type;
+    const char *portName;   // into the file, NULL unless type is IO
+    const char *portEnd;
+} NetLine_t;
+
 // read from netlist.txt and store netlist
 NetSet_t::NetSet_t(ifstream &file)
 {
-    file.clear();
-    file.seekg(0);
-    string line;
-    do {
-        getline(file, line);
-        if (file.good()) {
-#ifdef DEBUG    
-            cout << line << endl;
-#endif
-            parseAddNet(line);
+    MappedFile_t text(file, "connection file");
+    parse(text);
+}
+
+NetSet_t::NetSet_t(const char *fileName)
+{
+    MappedFile_t text(fileName);
+    parse(text);
+}
+
+// The contacts of all nets are scanned into one pool first, each net then
+// takes its range of it in a single allocation; type tokens and port names
+// are read in place.
+void
+NetSet_t::parse(const MappedFile_t &file)
+{
+    TextScanner_t scanner(file);
+    vector<oaPoint> pool;
+    // a contact takes at least 4 bytes ("x y ")
+    pool.reserve(file.size() / 8);
+    vector<NetLine_t> lines;
+    while (!scanner.atEnd()) {
+        if (scanner.atLineEnd()) {
+            scanner.endLine();
+            continue;
+        }
+        NetLine_t line;
+        line.first = pool.size();
+        line.portName = line.portEnd = NULL;
+        while (scanner.atInteger()) {
+            oaCoord x = scanner.integer("x coordinate");
+            oaCoord y = scanner.integer("y coordinate");
+            pool.push_back(oaPoint(x, y));
         }
-    } while (file.good());
-#ifdef DEBUG 
+        const char *first;
+        const char *last;
+        scanner.token("net type", first, last);
+        size_t length = last - first;
+        if (length == 3 && strncmp(first, "VDD", 3) == 0) {
+            line.type = VDD;
+        }
+        else if (length == 3 && strncmp(first, "VSS", 3) == 0) {
+            line.type = VSS;
+        }
+        else if (length == 1 && *first == 'S') {
+            line.type = S;
+        }
+        else if (length >= 3 && strncmp(first, "IO/", 3) == 0) {
+            line.type = IO;
+            line.portName = first + 3;
+            line.portEnd = last;
+        }
+        else {
+            scanner.fail(first, "unknown net type: " + string(first, last));
+        }
+        scanner.endLine();
+        lines.push_back(line);
+    }
+
+    reserve(lines.size());
+    for (size_t i = 0; i < lines.size(); ++i) {
+        size_t next = (i + 1 < lines.size()) ? lines[i + 1].first : pool.size();
+        oaString portName;
+        if (lines[i].type == IO) {
+            portName = oaString(string(lines[i].portName, lines[i].portEnd).c_str());
+        }
+        push_back(Net_t(pool.begin() + lines[i].first, pool.begin() + next, size(), \
+                    lines[i].type, portName));
+    }
+#ifdef DEBUG
+    print();
+#endif
+}
+
+void
+NetSet_t::print() const
+{
     const_iterator netIter;
     for (netIter = this->begin(); netIter != this->end(); ++netIter)
     {
@@ -39,54 +112,15 @@ NetSet_t::NetSet_t(ifstream &file)
         }
         cout << endl;
     }  
-#endif
 }
 
-// parse input text file and extract one net
-void
-NetSet_t::parseAddNet(const string &line)
+size_t
+NetSet_t::contactCount() const
 {
-    istringstream ss(line);
-    oaCoord coord1, coord2;
-    vector<oaPoint> points;
-    NetType_t type;
-    oaString portName;
-
-    while (ss >> coord1 >> coord2) {
-#ifdef DEBUG
-        cout << "Read contact positions: " << coord1 << " and " << coord2;
-        cout << endl;
-#endif
-        points.push_back(oaPoint(coord1, coord2));
-    }
-
-    string typeName;
-    ss.clear();
-    if (ss >> typeName) {
-        if (typeName == "VDD") {
-            type = VDD;
-        } 
-        else if (typeName == "VSS") {
-            type = VSS;
-        }
-        else if (typeName == "S") {
-            type = S;
-        }
-        else if (typeName.find("IO/") != string::npos) {
-            type = IO;
-            size_t pos = typeName.find("IO/") + 3;
-            portName = oaString(string(typeName, pos).c_str());
-#ifdef DEBUG
-            cout << "The port name is: " << portName << endl;         
-#endif
-        } else {
-            cerr << "Unknown net type: " << typeName << endl;
-            exit(1);
-        }
-        // push Net_t into NetSet_t 
-        this->push_back(Net_t(points, this->size(), type, portName));
-    } else {
-        cerr << "Invalid netlist format." << endl;
-        exit(1);
+    size_t count = 0;
+    const_iterator netIter;
+    for (netIter = begin(); netIter != end(); ++netIter) {
+        count += netIter->size();
     }
+    return count;
 }
@@ -2,16 +2,23 @@
 #define NETSET_H_
 #include <string>
 #include <fstream>
-#include "oaDesignDB.h"
+#include "Geometry.h"
 #include "Net.h"
 #include "RouterType.h"
+#include "TextParser.h"
 
 class NetSet_t : public std::vector<Net_t> {
 public:
+    // both throw a ParseError_t on malformed input
     NetSet_t(std::ifstream &file);
+    explicit NetSet_t(const char *fileName);
+    // total number of contacts of all nets
+    size_t contactCount() const;
 private:
-    // parse one line of input text, initialize a net and add it into NetSet
-    void parseAddNet(const std::string &line);
+    // one net per line: the contacts as x y pairs, then VDD, VSS, S or
+    // IO/port_name
+    void parse(const MappedFile_t &file);
+    void print() const;
 };
 
 #endif
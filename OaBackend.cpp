@@ -0,0 +1,75 @@
+#include <iostream>
+#include "OaBackend.h"
+#include "Log.h"
+
+using namespace oa;
+using namespace std;
+
+bool
+OaBackend_t::rails(oaBox &VDDBox, oaBox &VSSBox)
+{
+    // get bounding box of VDD rail and VSS rail
+    oaBlock *block = _design->getTopBlock();
+    
+    oaLayerHeader *m1LayerHeader;
+    m1LayerHeader = oaLayerHeader::find(block, 8);
+    if (NULL == m1LayerHeader) {
+        return false;
+    }
+
+    // get positions of VDD and VSS rails
+    oaIter<oaLPPHeader> LPPHeaderIter(m1LayerHeader->getLPPHeaders());
+    while (oaLPPHeader *LPPHeader = LPPHeaderIter.getNext()) {
+        oaIter<oaShape> shapeIter(LPPHeader->getShapes());
+        while (oaShape *shape = shapeIter.getNext()) {
+            if (shape->getType() == oacRectType) {
+                oaBox bbox;
+                shape->getBBox(bbox);
+                if (bbox.bottom() < 0) {
+                    // vss rail
+                    shape->getBBox(VSSBox);
+                } else {
+                    // vdd rail
+                    shape->getBBox(VDDBox);
+                }
+            }
+        }
+    }
+    return true;
+}
+
+void
+OaBackend_t::createLayers()
+{
+    // create metal2 layer and via1 layer if any of them does not exist
+    oaLayer * layer;
+
+    // check if via1 layer is in the database
+    layer =  oaLayer::find(_tech, "via1");
+    if (layer == NULL) {
+        INFO_LOG("Creating via1 layer");
+        oaPhysicalLayer::create(_tech, "via1", 11, oacMetalMaterial, 11);
+    }
+
+    // check if metal2 layer is in the database
+    layer =  oaLayer::find(_tech, "metal2");
+    if (layer == NULL) {
+        INFO_LOG("Creating metal2 layer");
+        oaPhysicalLayer::create(_tech, "metal2", 12, oacMetalMaterial, 12);
+    }
+}
+
+void
+OaBackend_t::createRect(oaLayerNum layer, const oaBox &box)
+{
+    oaRect::create(_design->getTopBlock(), layer, 1, box);
+}
+
+void
+OaBackend_t::createLabel(oaLayerNum layer, const oaPoint &origin, \
+        const oaString &label)
+{
+    oaText::create(_design->getTopBlock(), layer, 1, label, origin, \
+            oaTextAlign(oacLowerLeftTextAlign), oaOrient(oacR0), \
+            oaFont(oacRomanFont), oaDist(1000), false, true, true);
+}
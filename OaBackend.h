@@ -0,0 +1,24 @@
+// The class OaBackend_t reads the rails of a cell from its oaDesign and
+// creates the routed shapes in the design's top block.
+#ifndef OABACKEND_H_
+#define OABACKEND_H_
+
+#include "oaDesignDB.h"
+#include "LayoutBackend.h"
+
+class OaBackend_t : public LayoutBackend_t {
+public:
+    OaBackend_t(oa::oaDesign *design, oa::oaTech *tech)
+        : _design(design), _tech(tech) {}
+
+    bool rails(oa::oaBox &VDDBox, oa::oaBox &VSSBox);
+    void createLayers();
+    void createRect(oa::oaLayerNum layer, const oa::oaBox &box);
+    void createLabel(oa::oaLayerNum layer, const oa::oaPoint &origin, \
+            const oa::oaString &label);
+private:
+    oa::oaDesign *_design;
+    oa::oaTech *_tech;
+};
+
+#endif
@@ -0,0 +1,223 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstdio>
+#include <unistd.h>
+#include "RouteCache.h"
+
+using namespace oa;
+using namespace std;
+
+// first line of every entry, bump when the format or the key changes
+static const char *cacheVersion = "routecache 1";
+
+// 64-bit FNV-1a
+static oaUInt8
+fnv1a(const string &text)
+{
+    oaUInt8 hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < text.size(); ++i) {
+        hash ^= static_cast<unsigned char>(text[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static bool
+pointLess(const oaPoint &lhs, const oaPoint &rhs)
+{
+    return lhs.x() != rhs.x() ? lhs.x() < rhs.x() : lhs.y() < rhs.y();
+}
+
+RouteCache_t::RouteCache_t(const string &directory)
+    : _directory(directory), _hits(0), _misses(0), _stores(0)
+{
+    pthread_mutex_init(&_lock, NULL);
+}
+
+RouteCache_t::~RouteCache_t()
+{
+    pthread_mutex_destroy(&_lock);
+}
+
+oaBox
+RouteCache_t::toKey(const Key_t &key, const oaBox &box)
+{
+    if (key.mirrored) {
+        return oaBox(-box.right() - key.origin.x(), box.bottom() - key.origin.y(), \
+                -box.left() - key.origin.x(), box.top() - key.origin.y());
+    }
+    return oaBox(box.left() - key.origin.x(), box.bottom() - key.origin.y(), \
+            box.right() - key.origin.x(), box.top() - key.origin.y());
+}
+
+oaBox
+RouteCache_t::fromKey(const Key_t &key, const oaBox &box)
+{
+    if (key.mirrored) {
+        return oaBox(-box.right() - key.origin.x(), box.bottom() + key.origin.y(), \
+                -box.left() - key.origin.x(), box.top() + key.origin.y());
+    }
+    return oaBox(box.left() + key.origin.x(), box.bottom() + key.origin.y(), \
+            box.right() + key.origin.x(), box.top() + key.origin.y());
+}
+
+// The key text of one orientation: the rules, the rails and every net in
+// id order with its contacts sorted, contacts and rails as they sit after
+// the move. The router's result does not depend on the contact order
+// within a net as far as legality goes, so sorting loses nothing.
+void
+RouteCache_t::keyText(const NetSet_t &nets, const DRC_t &designRule, \
+        const oaBox &VDDBox, const oaBox &VSSBox, bool mirrored, Key_t &key)
+{
+    key.mirrored = mirrored;
+    key.origin = oaPoint(0, 0);
+    key.contactWidth = designRule.viaWidth();
+    oaBox VDD = toKey(key, VDDBox);
+    oaBox VSS = toKey(key, VSSBox);
+    key.origin = oaPoint(min(VDD.left(), VSS.left()), min(VDD.bottom(), VSS.bottom()));
+    VDD = toKey(key, VDDBox);
+    VSS = toKey(key, VSSBox);
+
+    ostringstream text;
+    text << "rules " << designRule.metalWidth() << " " << designRule.metalSpacing() << " ";
+    text << designRule.viaExtension() << " " << designRule.metalArea() << " ";
+    text << designRule.viaWidth() << " " << designRule.viaHeight() << "\n";
+    text << "rails " << VDD.left() << " " << VDD.bottom() << " " << VDD.right() << " ";
+    text << VDD.top() << " " << VSS.left() << " " << VSS.bottom() << " ";
+    text << VSS.right() << " " << VSS.top() << "\n";
+
+    vector<oaPoint> contacts;
+    NetSet_t::const_iterator netIter;
+    for (netIter = nets.begin(); netIter != nets.end(); ++netIter) {
+        contacts.clear();
+        Net_t::const_iterator citer;
+        for (citer = netIter->begin(); citer != netIter->end(); ++citer) {
+            oaBox contact(citer->x(), citer->y(), citer->x() + designRule.viaWidth(), \
+                    citer->y() + designRule.viaHeight());
+            contacts.push_back(toKey(key, contact).lowerLeft());
+        }
+        sort(contacts.begin(), contacts.end(), pointLess);
+        text << "net " << netIter->id() << " " << netIter->type() << " [";
+        text << netIter->portName() << "]";
+        for (size_t i = 0; i < contacts.size(); ++i) {
+            text << " " << contacts[i].x() << " " << contacts[i].y();
+        }
+        text << "\n";
+    }
+    key.text = text.str();
+}
+
+// both orientations are normalized, the one with the smaller text is the
+// key, so a cell and its mirror image get the same text
+void
+RouteCache_t::makeKey(const NetSet_t &nets, const DRC_t &designRule, \
+        const oaBox &VDDBox, const oaBox &VSSBox, Key_t &key)
+{
+    Key_t mirrored;
+    keyText(nets, designRule, VDDBox, VSSBox, false, key);
+    keyText(nets, designRule, VDDBox, VSSBox, true, mirrored);
+    if (mirrored.text < key.text) {
+        key = mirrored;
+    }
+    key.hash = fnv1a(key.text);
+}
+
+string
+RouteCache_t::path(const Key_t &key) const
+{
+    char name[32];
+    sprintf(name, "/%016llx.route", static_cast<unsigned long long>(key.hash));
+    return _directory + name;
+}
+
+// Entry format: the version line, the length of the key text and the
+// text itself (hash collisions are misses), the number of shapes and one
+// line per shape: kind net layer left bottom right top [label].
+bool
+RouteCache_t::load(const Key_t &key, vector<ShapeJournal_t::Shape_t> &shapes)
+{
+    pthread_mutex_lock(&_lock);
+    shapes.clear();
+    ifstream file(path(key).c_str(), ios::binary);
+    string line;
+    size_t length = 0;
+    size_t count = 0;
+    bool found = file.good() && getline(file, line) && line == cacheVersion && \
+        (file >> length) && file.get() == '\n';
+    if (found) {
+        string text(length, '\0');
+        found = file.read(&text[0], length) && text == key.text && (file >> count);
+    }
+    for (size_t i = 0; found && i < count; ++i) {
+        ShapeJournal_t::Shape_t shape;
+        int kind;
+        oaCoord left, bottom, right, top;
+        found = (file >> kind >> shape.netID >> shape.layer >> left >> bottom >> right >> top) \
+            && kind >= CONTACT_SHAPE && kind <= LABEL_SHAPE;
+        if (!found) {
+            break;
+        }
+        shape.kind = static_cast<ShapeKind_t>(kind);
+        if (shape.kind == LABEL_SHAPE) {
+            // a label sits on the lower left corner of a contact, which
+            // the mirror moves to the other side of the contact
+            getline(file, line);
+            shape.label = oaString(line.empty() ? "" : line.c_str() + 1);
+            oaBox corner = fromKey(key, oaBox(left, bottom, left + key.contactWidth, bottom));
+            shape.box = oaBox(corner.lowerLeft(), corner.lowerLeft());
+        }
+        else {
+            shape.box = fromKey(key, oaBox(left, bottom, right, top));
+        }
+        shapes.push_back(shape);
+    }
+    if (!found) {
+        shapes.clear();
+        ++_misses;
+    }
+    else {
+        ++_hits;
+    }
+    pthread_mutex_unlock(&_lock);
+    return found;
+}
+
+// written to a temporary file and renamed, so a reader never sees half
+// an entry, also when several processes share the directory
+bool
+RouteCache_t::store(const Key_t &key, const vector<ShapeJournal_t::Shape_t> &shapes)
+{
+    pthread_mutex_lock(&_lock);
+    string name = path(key);
+    ostringstream tmpName;
+    tmpName << name << ".tmp" << getpid() << "." << _stores++;
+
+    ofstream file(tmpName.str().c_str(), ios::binary);
+    file << cacheVersion << "\n" << key.text.size() << "\n" << key.text;
+    file << shapes.size() << "\n";
+    vector<ShapeJournal_t::Shape_t>::const_iterator it;
+    for (it = shapes.begin(); it != shapes.end(); ++it) {
+        if (it->kind == LABEL_SHAPE) {
+            oaBox corner = toKey(key, oaBox(it->box.left(), it->box.bottom(), \
+                        it->box.left() + key.contactWidth, it->box.bottom()));
+            file << it->kind << " " << it->netID << " " << it->layer << " ";
+            file << corner.left() << " " << corner.bottom() << " " << corner.left() << " ";
+            file << corner.bottom() << " " << it->label << "\n";
+        }
+        else {
+            oaBox box = toKey(key, it->box);
+            file << it->kind << " " << it->netID << " " << it->layer << " ";
+            file << box.left() << " " << box.bottom() << " " << box.right() << " ";
+            file << box.top() << "\n";
+        }
+    }
+    file.close();
+    bool stored = !file.fail() && rename(tmpName.str().c_str(), name.c_str()) == 0;
+    if (!stored) {
+        remove(tmpName.str().c_str());
+    }
+    pthread_mutex_unlock(&_lock);
+    return stored;
+}
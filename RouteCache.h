@@ -0,0 +1,60 @@
+// The class RouteCache_t keeps routed cells on disk, one file per cell
+// geometry. The key is the contacts, net types and port names, the design
+// rules and the rails, moved so the rails start at (0, 0) and mirrored in
+// x when that sorts first; cells that differ only by a translation or an
+// x mirror share one entry. Entries hold the routed shapes in the same
+// normalized coordinates and are moved back into each cell on a hit.
+#ifndef ROUTECACHE_H_
+#define ROUTECACHE_H_
+
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include "Geometry.h"
+#include "NetSet.h"
+#include "DRC.h"
+#include "ShapeJournal.h"
+
+class RouteCache_t {
+public:
+    // Key_t: the normalized geometry of a cell and how to get back to the
+    // cell, x' = (mirrored ? -x : x) - origin.x(), y' = y - origin.y()
+    typedef struct {
+        std::string text;
+        oa::oaUInt8 hash;
+        bool mirrored;
+        oa::oaPoint origin;
+        // contacts are labelled at their lower left corner
+        oa::oaCoord contactWidth;
+    } Key_t;
+
+    // entries are files in directory, which must exist
+    RouteCache_t(const std::string &directory);
+    ~RouteCache_t();
+
+    static void makeKey(const NetSet_t &nets, const DRC_t &designRule, \
+            const oa::oaBox &VDDBox, const oa::oaBox &VSSBox, Key_t &key);
+    // the routed shapes of key in cell coordinates, false on a miss
+    bool load(const Key_t &key, std::vector<ShapeJournal_t::Shape_t> &shapes);
+    // store the routed shapes, given in cell coordinates, of key
+    bool store(const Key_t &key, const std::vector<ShapeJournal_t::Shape_t> &shapes);
+
+    oa::oaUInt8 hits() const { return _hits; }
+    oa::oaUInt8 misses() const { return _misses; }
+private:
+    static void keyText(const NetSet_t &nets, const DRC_t &designRule, \
+            const oa::oaBox &VDDBox, const oa::oaBox &VSSBox, bool mirrored, \
+            Key_t &key);
+    static oa::oaBox toKey(const Key_t &key, const oa::oaBox &box);
+    static oa::oaBox fromKey(const Key_t &key, const oa::oaBox &box);
+    std::string path(const Key_t &key) const;
+
+    std::string _directory;
+    // guards the counters and the files, cells are routed concurrently
+    pthread_mutex_t _lock;
+    oa::oaUInt8 _hits;
+    oa::oaUInt8 _misses;
+    oa::oaUInt4 _stores;
+};
+
+#endif
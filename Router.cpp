@@ -1,8 +1,18 @@
 #include <vector>
+#include <set>
+#include <map>
+#include <cstdlib>
+#include <cmath>
 #include <algorithm>
+#include <queue>
+#include <cstring>
 #include <iostream>
+#include <sys/time.h>
 #include "Router.h"
 #include "EndPoint.h"
+#include "Scheduler.h"
+#include "Trace.h"
+#include "Log.h"
 
 using namespace oa;
 using namespace std;
@@ -12,6 +22,71 @@ static const oa::oaLayerNum METAL1 = 8;
 static const oa::oaLayerNum VIA1 = 11;
 static const oa::oaLayerNum METAL2 = 12;
 
+// current wall-clock time in seconds
+static double
+wallTime()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+#if ROUTER_LOG_LEVEL <= ROUTER_LOG_DEBUG
+// "(x, y) (x, y) ..." for log messages
+static string
+formatPoints(const PointSet_t &points)
+{
+    ostringstream ss;
+    PointSet_t::const_iterator it;
+    for (it = points.begin(); it != points.end(); ++it) {
+        ss << "(" << it->x() << ", " << it->y() << ") ";
+    }
+    return ss.str();
+}
+#endif
+
+// TileState_t: a tile reached by the tile search. The wire in the tile
+// is fixed to a coordinate in [low, high], x on metal1 and y on metal2;
+// at is where the search entered the tile and cost the length so far.
+typedef struct {
+    int layer;
+    size_t tile;
+    oaCoord low;
+    oaCoord high;
+    oaPoint at;
+    double cost;
+    long parent;
+} TileState_t;
+
+// TileQueue_t: open tile states, cheapest estimate first
+typedef priority_queue<pair<double, long>, vector<pair<double, long> >, \
+        greater<pair<double, long> > > TileQueue_t;
+
+static oaCoord
+clampCoord(oaCoord value, oaCoord low, oaCoord high)
+{
+    return (value < low) ? low : ((value > high) ? high : value);
+}
+
+static double
+manhattan(const oaPoint &lhs, const oaPoint &rhs)
+{
+    return fabs(static_cast<double>(lhs.x()) - rhs.x()) + \
+        fabs(static_cast<double>(lhs.y()) - rhs.y());
+}
+
+// whether a tile was already reached with an interval containing [low, high]
+static bool
+dominated(const vector<pair<oaCoord, oaCoord> > &seen, oaCoord low, oaCoord high)
+{
+    for (size_t i = 0; i < seen.size(); ++i) {
+        if (seen[i].first <= low && high <= seen[i].second) {
+            return true;
+        }
+    }
+    return false;
+}
+
 bool compx(const oaPoint &lhs, const oaPoint &rhs) {
     return lhs.x() < rhs.x();
 }
@@ -44,48 +119,210 @@ Comparator::operator()(const oaPoint &lhs, const oaPoint &rhs)
     return (distance1 < distance2);
 }
 
-class ContactsNumComparator {
-public:
-    ContactsNumComparator(const map<oaInt4, oaInt4> &contactsNum) : _contactsNum(contactsNum) {}
-    bool operator()(const Net_t &lhs, const Net_t &rhs) {
-        return _contactsNum[lhs.id()] < _contactsNum[rhs.id()];
-    }
-private:
-    map<oaInt4, oaInt4> _contactsNum;
-};
+// Corner_t: a prefix count of the contacts with x <= x and y <= y, added
+// to the count of net with sign
+typedef struct {
+    oaCoord x;
+    oaCoord y;
+    size_t net;
+    int sign;
+} Corner_t;
+
+static void
+addCorner(vector<Corner_t> &corners, size_t net, oaCoord x, oaCoord y, int sign)
+{
+    Corner_t corner;
+    corner.x = x;
+    corner.y = y;
+    corner.net = net;
+    corner.sign = sign;
+    corners.push_back(corner);
+}
 
+static bool
+cornerLess(const Corner_t &lhs, const Corner_t &rhs)
+{
+    return lhs.x < rhs.x;
+}
 
-Router_t::Router_t(oaDesign *design, oaTech *tech, ifstream &file1,\
-        ifstream &file2)
-    :_design(design), _tech(tech), _nets(file1), _designRule(file2)
+static bool
+xLess(const oaPoint &lhs, const oaPoint &rhs)
 {
-    // get bounding box of VDD rail and VSS rail
-    oaBlock *block = _design->getTopBlock();
-    
-    oaLayerHeader *m1LayerHeader;
-    m1LayerHeader = oaLayerHeader::find(block, 8);
-    if (NULL == m1LayerHeader) {
-        cerr << "Cannot open metal1 layer.\n";
-        exit(1);
+    return lhs.x() < rhs.x();
+}
+
+// compares the keys only, the positions just ride along
+static bool
+keyLess(const pair<oaInt8, size_t> &lhs, const pair<oaInt8, size_t> &rhs)
+{
+    return lhs.first < rhs.first;
+}
+
+// Portfolio_t: the portfolio workers and their outcome. firstRouted is the
+// lowest worker that routed every net; workers above it stop early, as
+// the lowest one wins.
+typedef struct {
+    vector<Router_t *> workers;
+    vector<char> routed;
+    size_t firstRouted;
+    pthread_mutex_t lock;
+} Portfolio_t;
+
+// escapes line probing gets before raceTwoContacts starts the racers
+static const oaUInt4 RACE_HEAD_PROBES = 32;
+
+// the engines racing in raceTwoContacts
+enum { PROBE_RACER, TILE_RACER, GRID_RACER, RACERS };
+
+// Race_t: one connection raced by the engines. The searches work on the
+// clearance blocks and areas of the other nets taken before the race.
+// found, paths and lengths hold what each racer recorded before the race
+// closed; running counts the racers not done yet.
+typedef struct {
+    Router_t *router;
+    EndPoint_t *lhs;
+    EndPoint_t *rhs;
+    oaPoint from;
+    oaPoint to;
+    oaInt4 netID;
+    vector<oaBox> m1Blocks;
+    oaBox m1Area;
+    vector<oaBox> m2Blocks;
+    oaBox m2Area;
+    oaBox region;
+    oaCoord pitch;
+    double viaCost;
+    CancelToken_t tokens[RACERS];
+    bool found[RACERS];
+    vector<oaPoint> paths[RACERS];
+    oaInt8 lengths[RACERS];
+    int running;
+    bool closed;
+    pthread_mutex_t lock;
+    pthread_cond_t finished;
+} Race_t;
+
+// RaceStart_t: argument of a racer thread
+typedef struct {
+    Race_t *race;
+    int racer;
+} RaceStart_t;
+
+static bool
+raceWon(const Race_t &race)
+{
+    for (int i = 0; i < RACERS; ++i) {
+        if (race.found[i]) {
+            return true;
+        }
     }
+    return false;
+}
 
-    // get positions of VDD and VSS rails
-    oaIter<oaLPPHeader> LPPHeaderIter(m1LayerHeader->getLPPHeaders());
-    while (oaLPPHeader *LPPHeader = LPPHeaderIter.getNext()) {
-        oaIter<oaShape> shapeIter(LPPHeader->getShapes());
-        while (oaShape *shape = shapeIter.getNext()) {
-            if (shape->getType() == oacRectType) {
-                oaBox bbox;
-                shape->getBBox(bbox);
-                if (bbox.bottom() < 0) {
-                    // vss rail
-                    shape->getBBox(_VSSBox);
-                } else {
-                    // vdd rail
-                    shape->getBBox(_VDDBox);
-                }
+// For every net, the contacts of the other nets inside its bounding box,
+// edges included. One sweep in x over all contacts with a Fenwick tree
+// over their y answers each box as four prefix counts; the contacts of a
+// net all lie in its own box and are subtracted.
+static void
+countContainedContacts(const NetSet_t &nets, vector<oaInt4> &counts)
+{
+    vector<oaPoint> points;
+    vector<oaCoord> ys;
+    vector<Corner_t> corners;
+    counts.assign(nets.size(), 0);
+    corners.reserve(4 * nets.size());
+    for (size_t i = 0; i < nets.size(); ++i) {
+        const Net_t &net = nets[i];
+        points.insert(points.end(), net.begin(), net.end());
+        counts[i] = -static_cast<oaInt4>(net.size());
+        if (net.empty()) {
+            continue;
+        }
+        const oaBox &box = net.bbox();
+        addCorner(corners, i, box.right(), box.top(), 1);
+        addCorner(corners, i, box.left() - 1, box.top(), -1);
+        addCorner(corners, i, box.right(), box.bottom() - 1, -1);
+        addCorner(corners, i, box.left() - 1, box.bottom() - 1, 1);
+    }
+    for (size_t i = 0; i < points.size(); ++i) {
+        ys.push_back(points[i].y());
+    }
+    sort(ys.begin(), ys.end());
+    ys.erase(unique(ys.begin(), ys.end()), ys.end());
+    sort(points.begin(), points.end(), xLess);
+    sort(corners.begin(), corners.end(), cornerLess);
+
+    // tree[k] counts the contacts added so far with y rank in
+    // (k - (k & -k), k]
+    vector<oaInt4> tree(ys.size() + 1, 0);
+    size_t next = 0;
+    vector<Corner_t>::const_iterator it;
+    for (it = corners.begin(); it != corners.end(); ++it) {
+        for (; next < points.size() && points[next].x() <= it->x; ++next) {
+            size_t k = lower_bound(ys.begin(), ys.end(), points[next].y()) - ys.begin() + 1;
+            for (; k < tree.size(); k += k & -k) {
+                ++tree[k];
             }
         }
+        oaInt4 below = 0;
+        size_t k = upper_bound(ys.begin(), ys.end(), it->y) - ys.begin();
+        for (; k > 0; k -= k & -k) {
+            below += tree[k];
+        }
+        counts[it->net] += it->sign * below;
+    }
+}
+
+// The bench corpus routes the same cells with 500 probes per connection
+// as without a limit. The default leaves room for larger cells and stops
+// a hopeless connection before it dominates the time of its cell.
+const oaUInt4 Router_t::DEFAULT_MAX_PROBES;
+const double Router_t::DEFAULT_MAX_SECONDS = 1;
+
+Router_t::Router_t(LayoutBackend_t &backend, ifstream &file1, ifstream &file2)
+    :_backend(&backend), _nets(file1), _designRule(file2), \
+     _maxProbes(DEFAULT_MAX_PROBES), _maxSeconds(DEFAULT_MAX_SECONDS), \
+     _probes(0), _totalProbes(0), \
+     _patternRouting(true), _connections(0), _patternRoutes(0), \
+     _engine(PROBE_ENGINE), _cache(NULL), _cached(false), _portfolio(0), \
+     _raceGrace(0), _cancel(NULL), _deadline(0), _failReason(NO_FAILURE)
+{
+    init();
+}
+
+// the files are mapped rather than read through a stream
+Router_t::Router_t(LayoutBackend_t &backend, const char *connectionFile, const char *ruleFile)
+    :_backend(&backend), _nets(connectionFile), _designRule(ruleFile), \
+     _maxProbes(DEFAULT_MAX_PROBES), _maxSeconds(DEFAULT_MAX_SECONDS), \
+     _probes(0), _totalProbes(0), \
+     _patternRouting(true), _connections(0), _patternRoutes(0), \
+     _engine(PROBE_ENGINE), _cache(NULL), _cached(false), _portfolio(0), \
+     _raceGrace(0), _cancel(NULL), _deadline(0), _failReason(NO_FAILURE)
+{
+    init();
+}
+
+// nets and designRule are already parsed, so parsing can be timed apart
+Router_t::Router_t(LayoutBackend_t &backend, const NetSet_t &nets, const DRC_t &designRule)
+    :_backend(&backend), _nets(nets), _designRule(designRule), \
+     _maxProbes(DEFAULT_MAX_PROBES), _maxSeconds(DEFAULT_MAX_SECONDS), \
+     _probes(0), _totalProbes(0), \
+     _patternRouting(true), _connections(0), _patternRoutes(0), \
+     _engine(PROBE_ENGINE), _cache(NULL), _cached(false), _portfolio(0), \
+     _raceGrace(0), _cancel(NULL), _deadline(0), _failReason(NO_FAILURE)
+{
+    init();
+}
+
+void
+Router_t::init()
+{
+    double start = wallTime();
+    _netStats = &_stats.other();
+    // get bounding box of VDD rail and VSS rail
+    if (!_backend->rails(_VDDBox, _VSSBox)) {
+        cerr << "Cannot open metal1 layer.\n";
+        exit(1);
     }
 #ifdef DEBUG
     cout << "VDD rail position: ";
@@ -99,8 +336,29 @@ Router_t::Router_t(oaDesign *design, oaTech *tech, ifstream &file1,\
     cout << endl;
 #endif
     // initialize obstacles
+    _initial = savepoint();
+    initObstacles();
+
+    // create metal2 layer and via1 layer if any of them does not exist
+    _backend->createLayers();
+    _stats.addPhase("init", wallTime() - start);
+}
+
+// Add the routing region and the contacts as obstacles and journal the
+// metal1 boxes of the contacts.
+void
+Router_t::initObstacles()
+{
     oaBox routeRegionBox(_VDDBox.left(), _VSSBox.top(), _VSSBox.right(), \
             _VDDBox.bottom());
+    // a barrier covers a point if the point is closer to its span than the
+    // clearance of a wire centre line
+    oaInt4 margin = _designRule.metalSpacing() + _designRule.metalWidth() / 2;
+    _m1Barriers.setMargin(margin);
+    _m2Barriers.setMargin(margin);
+    // all obstacles are known here, the indexes are built once over them
+    _m1Barriers.beginBulk();
+    _m2Barriers.beginBulk();
 
     addObstacle(METAL1, -1, routeRegionBox);
     addObstacle(METAL2, -1, routeRegionBox);
@@ -115,35 +373,60 @@ Router_t::Router_t(oaDesign *design, oaTech *tech, ifstream &file1,\
             oaBox m1Box(*citer, upperRight);
             m1Box.bottom() -= _designRule.viaExtension();
             m1Box.top() += _designRule.viaExtension();
-            oaRect::create(_design->getTopBlock(), METAL1, 1, m1Box);
-            // add all contacts as M1 obstacles
-            addObstacle(METAL1, netIter->id(), m1Box);
+            _journal.addRect(CONTACT_SHAPE, netIter->id(), METAL1, m1Box);
         }
+        // add all contacts as M1 obstacles
+        addContactObstacles(*netIter);
+        addContactPads(*netIter);
     }
-    
-
-    // create metal2 layer and via1 layer if any of them does not exist
-    oaLayer * layer;
+    _m1Barriers.endBulk();
+    _m2Barriers.endBulk();
+}
 
-    // check if via1 layer is in the database
-    layer =  oaLayer::find(_tech, "via1");
-    if (layer == NULL) {
-        cout << "Creating via1 layer\n";
-        oaPhysicalLayer::create(_tech, "via1", 11, oacMetalMaterial, 11);
+bool
+Router_t::route()
+{
+    double start = wallTime();
+    if (_cache != NULL) {
+        // the key follows the net order of the connection file
+        _cached = replayCached();
+        _stats.addPhase("cache", wallTime() - start);
+        if (_cached) {
+            return true;
+        }
+        start = wallTime();
     }
-
-    // check if metal2 layer is in the database
-    layer =  oaLayer::find(_tech, "metal2");
-    if (layer == NULL) {
-        cout << "Creating metal2 layer\n";
-        oaPhysicalLayer::create(_tech, "metal2", 12, oacMetalMaterial, 12);
+    reorderNets();
+    _stats.addPhase("reorderNets", wallTime() - start);
+
+    start = wallTime();
+    _failedNets.clear();
+    bool result;
+    if (_portfolio > 1 && _nets.size() > 3) {
+        // VDD and VSS first, reorderNets put them in front
+        result = routeNets(0, 2);
+        result = routePortfolio() && result;
+    }
+    else {
+        result = routeNets(0, _nets.size());
+    }
+    _stats.addPhase("route", wallTime() - start);
+    if (result) {
+        storeCached();
     }
+    return result;
 }
 
 bool
-Router_t::route()
+Router_t::reRoute()
 {
-    reorderNets();
+    double start = wallTime();
+    _designRule.restoreToMin();
+    // drop everything created so far, contacts are recreated with the
+    // minimum rules
+    rollback(_initial);
+    initObstacles();
+
     NetSet_t::const_iterator netIter;
     bool result = true;
 
@@ -151,117 +434,402 @@ Router_t::route()
         bool oneResult = routeOneNet(*netIter);
         result = oneResult && result;
     }
+    _stats.addPhase("reRoute", wallTime() - start);
     return result;
 }
 
+// Rip up the signal and IO nets that failed in route() together with the
+// nets whose wires run through their bounding boxes, then route the
+// failed nets first and the ripped-up blockers after them. Successful
+// nets elsewhere in the cell keep their wires. VDD and VSS nets only fail
+// on contact spacing, which rerouting cannot fix, so they are left alone.
 bool
-Router_t::reRoute()
+Router_t::rerouteFailedNets()
 {
-    _designRule.restoreToMin();
-    _m1Barriers.clear();
-    _m1Vlines.clear();
-    _m2Barriers.clear();
-    _m2Hlines.clear();
-    oaBox routeRegionBox(_VDDBox.left(), _VSSBox.top(), _VSSBox.right(), \
-            _VDDBox.bottom());
+    double start = wallTime();
+    vector<oaInt4> order;
+    vector<oaInt4>::const_iterator idIter;
+    bool result = true;
 
-    addObstacle(METAL1, -1, routeRegionBox);
-    addObstacle(METAL2, -1, routeRegionBox);
-    NetSet_t::const_iterator netIter;
-    // create metal1 for each contact
-    for (netIter = _nets.begin(); netIter != _nets.end(); ++netIter) {
-        Net_t::const_iterator citer;
-        for (citer = netIter->begin(); citer != netIter->end(); ++citer) {
-            oaPoint upperRight(citer->x() + _designRule.viaWidth(), \
-                    citer->y() + _designRule.viaHeight());
+    for (idIter = _failedNets.begin(); idIter != _failedNets.end(); ++idIter) {
+        const Net_t *net = findNet(*idIter);
+        if (net->type() == VDD || net->type() == VSS) {
+            result = false;
+            continue;
+        }
+        order.push_back(*idIter);
+    }
+    if (order.empty()) {
+        return result;
+    }
 
-            oaBox m1Box(*citer, upperRight);
-            m1Box.bottom() -= _designRule.viaExtension();
-            m1Box.top() += _designRule.viaExtension();
-            oaRect::create(_design->getTopBlock(), METAL1, 1, m1Box);
-            // add all contacts as M1 obstacles
-            addObstacle(METAL1, netIter->id(), m1Box);
+    // collect the nets blocking the failed ones
+    oaInt4 clearance = _designRule.metalSpacing() + _designRule.metalWidth();
+    size_t numFailed = order.size();
+    for (size_t i = 0; i < numFailed; ++i) {
+        oaBox region = findNet(order[i])->bbox();
+        region.left() -= clearance;
+        region.bottom() -= clearance;
+        region.right() += clearance;
+        region.top() += clearance;
+        ShapeJournal_t::const_iterator shapeIter;
+        for (shapeIter = _journal.begin(); shapeIter != _journal.end(); ++shapeIter) {
+            if (shapeIter->kind == CONTACT_SHAPE || shapeIter->netID < 0) {
+                continue;
+            }
+            const Net_t *blocker = findNet(shapeIter->netID);
+            if (blocker->type() != VDD && blocker->type() != VSS && \
+                    find(order.begin(), order.end(), shapeIter->netID) == order.end() && \
+                    shapeIter->box.overlaps(region)) {
+                order.push_back(shapeIter->netID);
+            }
         }
     }
 
-    bool result = true;
+    for (idIter = order.begin(); idIter != order.end(); ++idIter) {
+        ripUpNet(*idIter);
+    }
+    _failedNets.clear();
+    for (idIter = order.begin(); idIter != order.end(); ++idIter) {
+        if (!routeOneNet(*findNet(*idIter))) {
+            _failedNets.push_back(*idIter);
+            result = false;
+        }
+    }
+    _stats.addPhase("rerouteFailedNets", wallTime() - start);
+    if (result) {
+        storeCached();
+    }
+    return result;
+}
+
+// Remove the routed shapes of a net from the journal and its wires from
+// the obstacles. Its contacts stay in place. Savepoints taken before are
+// no longer valid afterwards.
+void
+Router_t::ripUpNet(oaInt4 netID)
+{
+    _journal.eraseRouted(netID);
 
+    vector<ConnectionFailure_t> failures;
+    vector<ConnectionFailure_t>::const_iterator failIter;
+    for (failIter = _failures.begin(); failIter != _failures.end(); ++failIter) {
+        if (failIter->netID != netID) {
+            failures.push_back(*failIter);
+        }
+    }
+    _failures.swap(failures);
+
+    _m1Barriers.eraseNet(netID);
+    _m2Barriers.eraseNet(netID);
+    _m1Vlines.eraseIf(BarrierOfNet(netID));
+    _m2Hlines.eraseIf(BarrierOfNet(netID));
+    vector<Obstacle_t> obstacles;
+    vector<Obstacle_t>::const_iterator obsIter;
+    for (obsIter = _obstacles.begin(); obsIter != _obstacles.end(); ++obsIter) {
+        if (obsIter->netID != netID) {
+            obstacles.push_back(*obsIter);
+        }
+    }
+    _obstacles.swap(obstacles);
+    addContactObstacles(*findNet(netID));
+}
+
+const Net_t *
+Router_t::findNet(oaInt4 netID) const
+{
+    NetSet_t::const_iterator netIter;
     for (netIter = _nets.begin(); netIter != _nets.end(); ++netIter) {
-        bool oneResult = routeOneNet(*netIter);
-        result = oneResult && result;
+        if (netIter->id() == netID) {
+            return &(*netIter);
+        }
+    }
+    cerr << "Unknown net: " << netID << endl;
+    exit(1);
+}
+
+void
+Router_t::setProbeBudget(oaUInt4 maxProbes, double maxSeconds)
+{
+    _maxProbes = maxProbes;
+    _maxSeconds = maxSeconds;
+}
+
+const char *
+Router_t::failReasonName(FailReason_t reason)
+{
+    switch (reason) {
+    case NO_FAILURE:
+        return "none";
+    case NO_ESCAPE:
+        return "noEscape";
+    case PROBE_LIMIT:
+        return "probeLimit";
+    case TIME_LIMIT:
+        return "timeLimit";
+    case NO_PATH:
+        return "noPath";
+    default:
+        return "unknown";
     }
-    return result;
 }
 
+bool
+Router_t::parseEngine(const char *name, Engine_t &engine)
+{
+    if (strcmp(name, "probe") == 0) {
+        engine = PROBE_ENGINE;
+    }
+    else if (strcmp(name, "tile") == 0) {
+        engine = TILE_ENGINE;
+    }
+    else if (strcmp(name, "fallback") == 0) {
+        engine = FALLBACK_ENGINE;
+    }
+    else if (strcmp(name, "grid") == 0) {
+        engine = GRID_ENGINE;
+    }
+    else if (strcmp(name, "race") == 0) {
+        engine = RACE_ENGINE;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+// Check the budget of the current connection, remember the first limit
+// that is hit.
+bool
+Router_t::budgetExceeded()
+{
+    if (_failReason != NO_FAILURE) {
+        return true;
+    }
+    if (_cancel != NULL && _cancel->cancelled()) {
+        // another engine won the race, the reason is never reported
+        _failReason = TIME_LIMIT;
+    }
+    else if (_maxProbes && _probes > _maxProbes) {
+        _failReason = PROBE_LIMIT;
+    }
+    else if (_maxSeconds > 0 && wallTime() > _deadline) {
+        _failReason = TIME_LIMIT;
+    }
+    return _failReason != NO_FAILURE;
+}
+
+// Put VDD and VSS first, then the other nets by the number of foreign
+// contacts inside their bounding box, fewest first.
 void
 Router_t::reorderNets()
 {
-    map<oaInt4, oaInt4> contactsNum;
-    NetSet_t::iterator netIter1, netIter2;
+    NetSet_t::iterator netIter;
+    if (_nets.size() < 2) {
+        return;
+    }
 
     // put VDD, VSS to the first two elements in _nets
-    for (netIter1 = _nets.begin(); netIter1 != _nets.end(); ++netIter1) {
-        if (netIter1->type() == VDD) {
-            // swap with the first element
-            Net_t temp = _nets.front();
-            _nets.front() = *netIter1;
-            *netIter1 = temp;
+    for (netIter = _nets.begin(); netIter != _nets.end(); ++netIter) {
+        if (netIter->type() == VDD) {
+            netIter->swap(_nets[0]);
         }
     }
-    for (netIter1 = _nets.begin(); netIter1 != _nets.end(); ++netIter1) {
-        if (netIter1->type() == VSS) {
-            // swap with the second element
-            netIter2 = _nets.begin();
-            ++netIter2;
-            Net_t temp = *netIter2;
-            *netIter2 = *netIter1;
-            *netIter1 = temp;
+    for (netIter = _nets.begin(); netIter != _nets.end(); ++netIter) {
+        if (netIter->type() == VSS) {
+            netIter->swap(_nets[1]);
         }
     }
 
-    for (netIter1 = _nets.begin(); netIter1 != _nets.end(); ++netIter1) {
-        contactsNum[netIter1->id()] = 0;
+    vector<oaInt4> contactsNum;
+    countContainedContacts(_nets, contactsNum);
+
+    // do not sort _nets[0] and _nets[1]. std::sort only looks at the
+    // comparisons, so sorting the keys makes the moves it would make on
+    // the nets; the nets are then permuted in place.
+    NetKeys_t keys;
+    keys.reserve(_nets.size() - 2);
+    for (size_t i = 2; i < _nets.size(); ++i) {
+        keys.push_back(make_pair(contactsNum[i], i));
     }
+    sort(keys.begin(), keys.end(), keyLess);
+    permuteNets(keys, 2);
+}
 
-    for (netIter1 = _nets.begin(); netIter1 != _nets.end(); ++netIter1) {
-        for (netIter2 = _nets.begin(); netIter2 != _nets.end(); ++netIter2) {
-            if (netIter2 != netIter1) {
-                for (Net_t::const_iterator it = netIter2->begin(); \
-                        it != netIter2->end(); ++it) {
-                    if (netIter1->contains(*it)) {
-                        contactsNum[netIter1->id()] += 1;
-                    }
-                }
-            }
+// keys holds the positions first, first + 1, ... in some order
+void
+Router_t::permuteNets(const NetKeys_t &keys, size_t first)
+{
+    for (size_t i = 0; i < keys.size(); ++i) {
+        // the net that belongs here was swapped away if it came from an
+        // earlier position, follow it
+        size_t source = keys[i].second;
+        while (source < i + first) {
+            source = keys[source - first].second;
+        }
+        _nets[i + first].swap(_nets[source]);
+    }
+}
+
+bool
+Router_t::routeNets(size_t first, size_t last)
+{
+    bool result = true;
+    for (size_t i = first; i < last; ++i) {
+        if (!routeOneNet(_nets[i])) {
+            _failedNets.push_back(_nets[i].id());
+            result = false;
         }
     }
-    ContactsNumComparator comp(contactsNum);
-    netIter1 = _nets.begin();
-    ++netIter1;
-    ++netIter1;
-    // do not sort _nets[0] and _nets[1]
-    sort(netIter1, _nets.end(), comp);
+    return result;
+}
 
-    return;
+const char *
+Router_t::orderingName(unsigned worker)
+{
+    switch (worker) {
+    case 0:
+        return "contacts";
+    case 1:
+        return "area";
+    case 2:
+        return "half-perimeter";
+    default:
+        return "random";
+    }
+}
+
+// Worker 0 keeps the contact count order of reorderNets, 1 and 2 take
+// the nets by bounding box area and half-perimeter, smallest first, ties
+// in the contact count order. The others shuffle with their own seed.
+void
+Router_t::orderNets(unsigned worker)
+{
+    NetKeys_t keys;
+    for (size_t i = 2; i < _nets.size(); ++i) {
+        const oaBox &box = _nets[i].bbox();
+        oaInt8 width = box.getWidth();
+        oaInt8 height = box.getHeight();
+        keys.push_back(make_pair(worker == 1 ? width * height : width + height, i));
+    }
+    if (worker == 0) {
+        return;
+    }
+    else if (worker <= 2) {
+        stable_sort(keys.begin(), keys.end(), keyLess);
+    }
+    else {
+        // Fisher-Yates with a 64-bit LCG, rand() is shared by all threads
+        oaUInt8 state = 0x9e3779b97f4a7c15ULL * worker;
+        for (size_t i = keys.size(); i > 1; --i) {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            swap(keys[i - 1], keys[(state >> 33) % i]);
+        }
+    }
+    permuteNets(keys, 2);
+}
+
+// Fork one copy of the router per worker, VDD and VSS already routed,
+// and route the other nets in each worker's order on the scheduler
+// threads. The lowest worker that routes every net wins, otherwise the
+// one with the fewest failed nets; its state replaces this router's.
+bool
+Router_t::routePortfolio()
+{
+    Portfolio_t run;
+    run.routed.assign(_portfolio, 0);
+    run.firstRouted = _portfolio;
+    pthread_mutex_init(&run.lock, NULL);
+    for (unsigned i = 0; i < _portfolio; ++i) {
+        Router_t *worker = new Router_t(*this);
+        // a copy points to the stats of this router
+        worker->_netStats = &worker->_stats.other();
+        worker->orderNets(i);
+        run.workers.push_back(worker);
+    }
+    Scheduler_t scheduler(_portfolio);
+    scheduler.run(vector<double>(_portfolio, 1), portfolioWorker, &run);
+    pthread_mutex_destroy(&run.lock);
+
+    size_t best = 0;
+    for (size_t i = 1; i < run.workers.size(); ++i) {
+        if (run.routed[best]) {
+            break;
+        }
+        if (run.routed[i] || \
+                run.workers[i]->_failedNets.size() < run.workers[best]->_failedNets.size()) {
+            best = i;
+        }
+    }
+    bool result = run.routed[best];
+    DEBUG_LOG("Portfolio: " << orderingName(best) << " ordering of worker " << best << \
+            (result ? " routed all nets" : " routed the most nets"));
+    *this = *run.workers[best];
+    _netStats = &_stats.other();
+    for (size_t i = 0; i < run.workers.size(); ++i) {
+        delete run.workers[i];
+    }
+    return result;
+}
+
+void
+Router_t::portfolioWorker(size_t job, void *context)
+{
+    Portfolio_t &run = *static_cast<Portfolio_t *>(context);
+    Router_t &router = *run.workers[job];
+    bool result = true;
+    for (size_t i = 2; i < router._nets.size(); ++i) {
+        pthread_mutex_lock(&run.lock);
+        bool lost = run.firstRouted < job;
+        pthread_mutex_unlock(&run.lock);
+        if (lost) {
+            // cannot win any more, count the rest as failed
+            for (; i < router._nets.size(); ++i) {
+                router._failedNets.push_back(router._nets[i].id());
+            }
+            return;
+        }
+        if (!router.routeOneNet(router._nets[i])) {
+            router._failedNets.push_back(router._nets[i].id());
+            result = false;
+        }
+    }
+    run.routed[job] = result;
+    if (result) {
+        pthread_mutex_lock(&run.lock);
+        run.firstRouted = min(run.firstRouted, job);
+        pthread_mutex_unlock(&run.lock);
+    }
 }
 
 
 bool
 Router_t::routeOneNet(const Net_t &net)
 {
+    _netStats = &_stats.net(net.id(), net.type());
+    ++_netStats->attempts;
+    double start = wallTime();
+    bool result = false;
     switch (net.type()) {
     case VDD:
-        return routeVDD(net);
+        result = routeVDD(net);
+        break;
     case VSS:
-        return routeVSS(net);
+        result = routeVSS(net);
+        break;
     case S:
-        return routeSignal(net);
+        result = routeSignal(net);
+        break;
     case IO:
-        return routeIO(net);
+        result = routeIO(net);
+        break;
     default:
         cerr << "Unknow NetType_t detected..." << endl;
         exit(1);
     }
+    _netStats->seconds += wallTime() - start;
+    _netStats = &_stats.other();
+    return result;
 }
 
 bool
@@ -320,7 +888,7 @@ Router_t::routeVDD(const Net_t &net)
         return true;
     }
     else {
-        cout << "DRC violation in routing VDD net." << endl;
+        WARN_LOG("DRC violation in routing VDD net.");
         return false;
     }
 }
@@ -382,7 +950,7 @@ Router_t::routeVSS(const Net_t &net)
         return true;
     }
     else {
-        cout << "DRC violation in routing VSS net." << endl;
+        WARN_LOG("DRC violation in routing VSS net.");
         return false;
     }
 }
@@ -407,7 +975,7 @@ Router_t::routeSignal(const Net_t &net)
                 wireTop += (_designRule.viaHeight() + _designRule.viaExtension());
                 wireBottom -= (_designRule.viaExtension());
                 oaBox wireBox(wireLeft, wireBottom, wireRight, wireTop);
-                oaRect::create(_design->getTopBlock(), METAL1, 1, wireBox);
+                createRect(METAL1, net.id(), wireBox);
                 addObstacle(METAL1, net.id(), wireBox);
             }
             else {
@@ -433,7 +1001,7 @@ Router_t::routeSignal(const Net_t &net)
                     wireTop += (_designRule.viaHeight() + _designRule.viaExtension());
                     wireBottom -= (_designRule.viaExtension());
                     oaBox wireBox(wireLeft, wireBottom, wireRight, wireTop);
-                    oaRect::create(_design->getTopBlock(), METAL1, 1, wireBox);
+                    createRect(METAL1, net.id(), wireBox);
                     addObstacle(METAL1, net.id(), wireBox);
                 }
                 else {
@@ -500,12 +1068,10 @@ Router_t::routeIO(const Net_t &net)
     oaCoord wireTop = it1->y() + _designRule.viaHeight() + \
                       _designRule.viaExtension();
     oaBox wireBox(wireLeft, wireBottom, wireRight, wireTop);
-    oaRect::create(_design->getTopBlock(), METAL1, 1, wireBox);
+    createRect(METAL1, net.id(), wireBox);
     addObstacle(METAL1, net.id(), wireBox);
     // create oaText on metal1
-    oaText::create(_design->getTopBlock(), METAL1, 1, net.portName(), \
-            *it1, oaTextAlign(oacLowerLeftTextAlign), oaOrient(oacR0), \
-            oaFont(oacRomanFont), oaDist(1000), false, true, true);
+    _journal.addLabel(net.id(), METAL1, *it1, net.portName());
 
     for (; it2 != net.end(); ++it1, ++it2) {
         oaInt4 xdiff = it1->x() - it2->x();
@@ -520,7 +1086,7 @@ Router_t::routeIO(const Net_t &net)
             wireBottom -= (_designRule.viaExtension());
 
             oaBox wireBox(wireLeft, wireBottom, wireRight, wireTop);
-            oaRect::create(_design->getTopBlock(), METAL1, 1, wireBox);
+            createRect(METAL1, net.id(), wireBox);
             addObstacle(METAL1, net.id(), wireBox);
             continue;
         }
@@ -535,23 +1101,250 @@ Router_t::routeIO(const Net_t &net)
     return result;
 }
 
-// Route two contacts using line-probing algorithm as described in
-// "A Solution to line-routing problems on the continuous plane"
+// Connect two contacts: a pattern route if one is clear, then the
+// selected engine. A failed connection is recorded with its reason.
 bool
 Router_t::routeTwoContacts(EndPoint_t &lhs, EndPoint_t &rhs)
 {
     // two contacts are represented by two leftdown points of their actual
     // box, now we move these two points to the center of contact bounding box
-    
+    ConnectionFailure_t failure;
+    failure.netID = lhs.netID();
+    failure.from = lhs.getObjectPoint();
+    failure.to = rhs.getObjectPoint();
+
+    ++_connections;
+    ++_netStats->connections;
+    RoutePath_t path;
+    if (_patternRouting && planPattern(failure.from, failure.to, failure.netID, path)) {
+        commitPath(path, failure.netID);
+        ++_patternRoutes;
+        ++_netStats->patternRoutes;
+        return true;
+    }
+
+    _failReason = NO_FAILURE;
+    double start = wallTime();
+    bool routed = (_engine == RACE_ENGINE) ? raceTwoContacts(lhs, rhs) : \
+        engineTwoContacts(lhs, rhs);
+    _stats.addLatency(wallTime() - start);
+    if (routed) {
+        return true;
+    }
+    failure.reason = _failReason;
+    _failures.push_back(failure);
+    ++_netStats->failures[failure.reason];
+    return false;
+}
+
+bool
+Router_t::engineTwoContacts(EndPoint_t &lhs, EndPoint_t &rhs)
+{
+    oaPoint from = lhs.getObjectPoint();
+    oaPoint to = rhs.getObjectPoint();
+    RoutePath_t path;
+    if (_engine == GRID_ENGINE && planGrid(from, to, lhs.netID(), path)) {
+        commitPath(path, lhs.netID());
+        ++_netStats->gridRoutes;
+        return true;
+    }
+    if (_engine != TILE_ENGINE && probeTwoContacts(lhs, rhs)) {
+        return true;
+    }
+    if (_engine != PROBE_ENGINE && _engine != GRID_ENGINE) {
+        if (planTiles(from, to, lhs.netID(), path)) {
+            commitPath(path, lhs.netID());
+            ++_netStats->tileRoutes;
+            return true;
+        }
+        if (_engine == TILE_ENGINE) {
+            _failReason = NO_PATH;
+        }
+    }
+    return false;
+}
+
+// Race line probing, the tile search and the track grid on one
+// connection, each on its own thread, if line probing alone does not
+// route it within RACE_HEAD_PROBES escapes. Probing works on this router
+// from a savepoint; the searches build their own tile planes and grid
+// from the clearance blocks taken here, so nothing is copied that probing
+// changes while they run. The race closes when the first path is found, or once the
+// grace window after it is over, and the shortest path recorded by then
+// wins; the other racers are cancelled and probing is rolled back unless
+// it won.
+bool
+Router_t::raceTwoContacts(EndPoint_t &lhs, EndPoint_t &rhs)
+{
+    // head start: most connections take line probing a few escapes, which
+    // costs less than starting the racers
+    EndPoint_t lhsStart(lhs);
+    EndPoint_t rhsStart(rhs);
+    oaUInt4 maxProbes = _maxProbes;
+    _maxProbes = (maxProbes && maxProbes < RACE_HEAD_PROBES) ? maxProbes : RACE_HEAD_PROBES;
+    bool routed = probeTwoContacts(lhs, rhs);
+    _maxProbes = maxProbes;
+    if (routed) {
+        return true;
+    }
+    lhs = lhsStart;
+    rhs = rhsStart;
+    _failReason = NO_FAILURE;
+
+    Savepoint_t point = savepoint();
+    Race_t race;
+    race.router = this;
+    race.lhs = &lhs;
+    race.rhs = &rhs;
+    race.from = lhs.getObjectPoint();
+    race.to = rhs.getObjectPoint();
+    race.netID = lhs.netID();
+    clearanceBlocks(race.netID, race.m1Blocks, race.m1Area, race.m2Blocks, race.m2Area);
+    race.region = oaBox(_VDDBox.left(), _VSSBox.top(), _VSSBox.right(), _VDDBox.bottom());
+    race.pitch = _designRule.metalWidth() + _designRule.metalSpacing();
+    race.viaCost = _designRule.viaWidth() + _designRule.metalSpacing();
+    for (int i = 0; i < RACERS; ++i) {
+        race.found[i] = false;
+        race.lengths[i] = 0;
+    }
+    race.running = RACERS;
+    race.closed = false;
+    pthread_mutex_init(&race.lock, NULL);
+    pthread_cond_init(&race.finished, NULL);
+    _cancel = &race.tokens[PROBE_RACER];
+
+    pthread_t handles[RACERS];
+    RaceStart_t starts[RACERS];
+    for (int i = 0; i < RACERS; ++i) {
+        starts[i].race = &race;
+        starts[i].racer = i;
+        if (pthread_create(&handles[i], NULL, raceWorker, &starts[i]) != 0) {
+            cerr << "Cannot create thread." << endl;
+            exit(1);
+        }
+    }
+    pthread_mutex_lock(&race.lock);
+    while (race.running > 0 && !raceWon(race)) {
+        pthread_cond_wait(&race.finished, &race.lock);
+    }
+    if (race.running > 0 && _raceGrace > 0) {
+        double until = wallTime() + _raceGrace;
+        struct timespec deadline;
+        deadline.tv_sec = static_cast<time_t>(until);
+        deadline.tv_nsec = static_cast<long>((until - deadline.tv_sec) * 1e9);
+        while (race.running > 0 && \
+                pthread_cond_timedwait(&race.finished, &race.lock, &deadline) == 0) {
+        }
+    }
+    race.closed = true;
+    pthread_mutex_unlock(&race.lock);
+    for (int i = 0; i < RACERS; ++i) {
+        race.tokens[i].cancel();
+    }
+    for (int i = 0; i < RACERS; ++i) {
+        pthread_join(handles[i], NULL);
+    }
+    _cancel = NULL;
+    pthread_cond_destroy(&race.finished);
+    pthread_mutex_destroy(&race.lock);
+
+    int winner = -1;
+    for (int i = 0; i < RACERS; ++i) {
+        if (race.found[i] && (winner < 0 || race.lengths[i] < race.lengths[winner])) {
+            winner = i;
+        }
+    }
+    DEBUG_LOG("Race of net " << race.netID << " won by " << \
+            (winner == PROBE_RACER ? "line probing" : winner == TILE_RACER ? "the tile search" : \
+             winner == GRID_RACER ? "the track grid" : "no engine"));
+    if (winner == PROBE_RACER) {
+        return true;
+    }
+    rollback(point);
+    if (winner < 0) {
+        if (_failReason == NO_FAILURE) {
+            _failReason = NO_PATH;
+        }
+        return false;
+    }
+    _failReason = NO_FAILURE;
+    commitPath(race.paths[winner], race.netID);
+    if (winner == TILE_RACER) {
+        ++_netStats->tileRoutes;
+    }
+    else {
+        ++_netStats->gridRoutes;
+    }
+    return true;
+}
+
+// one racer of raceTwoContacts; its path counts only if the race is
+// still open when it finishes
+void *
+Router_t::raceWorker(void *arg)
+{
+    const RaceStart_t &start = *static_cast<RaceStart_t *>(arg);
+    Race_t &race = *start.race;
+    const CancelToken_t *cancel = &race.tokens[start.racer];
+    RoutePath_t path;
+    bool found = false;
+    oaInt8 length = 0;
+    if (start.racer == PROBE_RACER) {
+        size_t first = race.router->_obstacles.size();
+        found = race.router->probeTwoContacts(*race.lhs, *race.rhs);
+        length = found ? race.router->wireLength(first) : 0;
+    }
+    else if (start.racer == TILE_RACER) {
+        TilePlane_t m1Tiles;
+        TilePlane_t m2Tiles;
+        m1Tiles.build(race.m1Area, race.m1Blocks, VERTICAL);
+        m2Tiles.build(race.m2Area, race.m2Blocks, HORIZONTAL);
+        found = searchTiles(m1Tiles, m2Tiles, race.from, race.to, race.viaCost, path, cancel);
+        length = found ? pathLength(path) : 0;
+    }
+    else {
+        TrackGrid_t grid;
+        grid.reset(race.region, race.from, race.pitch);
+        found = grid.onGrid(race.to) && searchGrid(grid, race.m1Area, race.m1Blocks, \
+                race.m2Area, race.m2Blocks, race.from, race.to, path, cancel);
+        length = found ? pathLength(path) : 0;
+    }
+
+    pthread_mutex_lock(&race.lock);
+    if (found && !race.closed) {
+        race.found[start.racer] = true;
+        race.paths[start.racer].swap(path);
+        race.lengths[start.racer] = length;
+    }
+    --race.running;
+    pthread_cond_signal(&race.finished);
+    pthread_mutex_unlock(&race.lock);
+    return NULL;
+}
+
+// Route two contacts using line-probing algorithm as described in
+// "A Solution to line-routing problems on the continuous plane"
+bool
+Router_t::probeTwoContacts(EndPoint_t &lhs, EndPoint_t &rhs)
+{
     bool intersect = false;
     EndPoint_t *src = &lhs;
     EndPoint_t *dst = &rhs;
     oaPoint intersectionPoint;
 
+    _probes = 0;
+    _deadline = wallTime() + _maxSeconds;
+
     // Algorithm begins
     while (!intersect) {
+        if (budgetExceeded()) {
+            countEscapePoints(lhs, rhs);
+            return false;
+        }
         if (src->noEscape()) {
             if (dst->noEscape()) {
+                _failReason = NO_ESCAPE;
+                countEscapePoints(lhs, rhs);
                 return false;
             }
             else {
@@ -573,55 +1366,38 @@ Router_t::routeTwoContacts(EndPoint_t &lhs, EndPoint_t &rhs)
     }
     // apply refinement algorithm
     
-    PointSet_t points1 = src->escapePoints();
-    PointSet_t points2 = dst->escapePoints();
-    PointSet_t::const_iterator it;
-    cout << "Escape point of src are: " << endl;
-    for (it = points1.begin(); it != points1.end(); ++it) {
-        cout << "(" << it->x() << ", " << it->y() << ") ";
-    } 
-    cout << endl;
-    cout << "Cross point is: (" << intersectionPoint.x() << ", ";
-    cout << intersectionPoint.y() << ")" << endl;
+    DEBUG_LOG("Escape point of src are: " << formatPoints(src->escapePoints()));
+    DEBUG_LOG("Cross point is: (" << intersectionPoint.x() << ", " << \
+            intersectionPoint.y() << ")");
     // create a metal1 layer around cross point
     //oaRect::create(_design->getTopBlock(), METAL1, 1, oaBox(intersectionPoint, 800));
-    cout << "Escape point of dst are: " << endl;
-    for (it = points2.begin(); it != points2.end(); ++it) {
-        cout << "(" << it->x() << ", " << it->y() << ") ";
-    }
-    cout << endl;
-    
-    src->getCornerPoints(intersectionPoint);
-    dst->getCornerPoints(intersectionPoint);
-    //PointSet_t::const_iterator it;
-    cout << "Corner points of src are as follows:" << endl;
-    for (it = src->cornerPoints().begin(); it != src->cornerPoints().end(); ++it) {
-        cout << "(" << it->x() << ", " << it->y() << ") ";
-    }
-    cout << endl;
+    DEBUG_LOG("Escape point of dst are: " << formatPoints(dst->escapePoints()));
     
-    cout << "Corner points of dst are as follows:" << endl;
-    for (it = dst->cornerPoints().begin(); it != dst->cornerPoints().end(); ++it) {
-        cout << "(" << it->x() << ", " << it->y() << ") ";
+    if (!src->getCornerPoints(intersectionPoint) || !dst->getCornerPoints(intersectionPoint)) {
+        _failReason = NO_ESCAPE;
+        countEscapePoints(lhs, rhs);
+        return false;
     }
-    cout << endl;
-    cout << endl;
+    countEscapePoints(lhs, rhs);
+    _netStats->cornerPoints += src->cornerPoints().size() + dst->cornerPoints().size();
+    DEBUG_LOG("Corner points of src are: " << formatPoints(src->cornerPoints()));
+    DEBUG_LOG("Corner points of dst are: " << formatPoints(dst->cornerPoints()));
 
     // connect cornerPoints and intersectionPoint
     // create via for intersectionPoint
     
     if (intersectionPoint != src->cornerPoints().back() && \
             intersectionPoint != dst->cornerPoints().back()) {
-        createVia(intersectionPoint);
+        createVia(intersectionPoint, src->netID());
     }
     else if (intersectionPoint == src->cornerPoints().back()) {
         if (intersectionPoint.y() == dst->cornerPoints().front().y()) {
-            createVia(intersectionPoint);
+            createVia(intersectionPoint, src->netID());
         }
     }
     else {
         if (intersectionPoint.y() == src->cornerPoints().front().y()) {
-            createVia(intersectionPoint);
+            createVia(intersectionPoint, src->netID());
         }
     }
     
@@ -634,19 +1410,19 @@ Router_t::routeTwoContacts(EndPoint_t &lhs, EndPoint_t &rhs)
     // may need to create via for it1
     if (*it1 == src->cornerPoints().back()) {
         if (intersectionPoint != *it1 && intersectionPoint.y() == it1->y()) {
-            createVia(*it1);
+            createVia(*it1, src->netID());
         }
     }
     
     for (; it2 != src->cornerPoints().end(); ++it1, ++it2) {
         createWire(*it1, *it2, src->netID());
-        createVia(*it1);
+        createVia(*it1, src->netID());
         
         // may need to createVia for contact
         if (*it2 == src->cornerPoints().back()) {
             if (it1->y() == it2->y()) {
                 // contact is connected to metal2 layer
-                createVia(*it2);
+                createVia(*it2, src->netID());
             }
         }
         
@@ -660,19 +1436,19 @@ Router_t::routeTwoContacts(EndPoint_t &lhs, EndPoint_t &rhs)
     
     if (*it1 == dst->cornerPoints().back()) {
         if (intersectionPoint != *it1 && intersectionPoint.y() == it1->y()) {
-            createVia(*it1);
+            createVia(*it1, dst->netID());
         }
     }
     
     for (; it2 != dst->cornerPoints().end(); ++it1, ++it2) {
         createWire(*it1, *it2, dst->netID());
-        createVia(*it1);
+        createVia(*it1, dst->netID());
         
         // may need to create Via for contact
         if (*it2 == dst->cornerPoints().back()) {
             if (it1->y() == it2->y()) {
                 // contact is connected to metal2 layer
-                createVia(*it2);
+                createVia(*it2, dst->netID());
             }
         }
         
@@ -680,13 +1456,437 @@ Router_t::routeTwoContacts(EndPoint_t &lhs, EndPoint_t &rhs)
     return true;
 }
 
+// Most connections need no more than two bends. Try a straight route, the
+// two L routes and Z routes bending at a quarter, half and three quarters
+// of the way, fewest vias first, and keep the first one that is clear.
+bool
+Router_t::planPattern(const oaPoint &from, const oaPoint &to, oaInt4 netID, \
+        RoutePath_t &path)
+{
+    oaCoord dx = to.x() - from.x();
+    oaCoord dy = to.y() - from.y();
+    path.clear();
+    path.push_back(from);
+    if (dx == 0 || dy == 0) {
+        path.push_back(to);
+        return pathClear(path, netID);
+    }
+
+    // L: vertical first, then horizontal first
+    path.push_back(oaPoint(from.x(), to.y()));
+    path.push_back(to);
+    if (pathClear(path, netID)) {
+        return true;
+    }
+    path[1] = oaPoint(to.x(), from.y());
+    if (pathClear(path, netID)) {
+        return true;
+    }
+
+    // Z: vertical-horizontal-vertical needs vias at the bends only
+    static const int fractions[] = {2, 1, 3};
+    path.insert(path.begin() + 1, from);
+    for (int i = 0; i < 3; ++i) {
+        oaCoord y = from.y() + dy * fractions[i] / 4;
+        path[1] = oaPoint(from.x(), y);
+        path[2] = oaPoint(to.x(), y);
+        if (y != from.y() && y != to.y() && pathClear(path, netID)) {
+            return true;
+        }
+    }
+    for (int i = 0; i < 3; ++i) {
+        oaCoord x = from.x() + dx * fractions[i] / 4;
+        path[1] = oaPoint(x, from.y());
+        path[2] = oaPoint(x, to.y());
+        if (x != from.x() && x != to.x() && pathClear(path, netID)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// A path is clear if no bend lies inside a box of another net and every
+// segment keeps its spacing to the barriers of other nets.
+bool
+Router_t::pathClear(const RoutePath_t &path, oaInt4 netID)
+{
+    for (size_t i = 1; i + 1 < path.size(); ++i) {
+        line_t covers[4];
+        coversAt(path[i], netID, covers);
+        if (sameBox(covers[LEFT], covers[RIGHT]) || sameBox(covers[BOTTOM], covers[TOP])) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i + 1 < path.size(); ++i) {
+        if (!segmentClear(path[i], path[i + 1], netID)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The wire createWire() would create for the segment, extended at both
+// ends to enclose a via, must not come closer than metalSpacing to an
+// edge of another net on its layer: neither to one across the segment
+// (the barriers) nor to one running alongside it (the line sets). On
+// metal2 that includes the pads of the contacts of other nets.
+bool
+Router_t::segmentClear(const oaPoint &from, const oaPoint &to, oaInt4 netID)
+{
+    ++_netStats->coverQueries;
+    oaInt4 spacing = _designRule.metalSpacing();
+    oaInt4 margin = spacing + _designRule.metalWidth() / 2;
+    line_t barrier;
+    if (from.x() == to.x()) {
+        // metal1
+        oaCoord low = min(from.y(), to.y());
+        oaCoord high = max(from.y(), to.y());
+        oaInt4 extension = _designRule.viaHeight() / 2 + _designRule.viaExtension();
+        if (_m1Barriers.findAfter(low - extension - spacing, from.x(), netID, barrier) && \
+                barrier.first.y() < high + extension + spacing) {
+            return false;
+        }
+        BarrierSet_t::iterator it = _m1Vlines.upper_bound(from.x() - margin);
+        for (; it != _m1Vlines.end() && coord(it) < from.x() + margin; ++it) {
+            const line_t &edge = lineSeg(it);
+            if (it->second.first != netID && edge.first.y() < high + extension + spacing && \
+                    edge.second.y() > low - extension - spacing) {
+                return false;
+            }
+        }
+        return true;
+    }
+    // metal2
+    oaCoord low = min(from.x(), to.x());
+    oaCoord high = max(from.x(), to.x());
+    oaInt4 extension = _designRule.viaWidth() / 2 + _designRule.viaExtension();
+    if (_m2Barriers.findAfter(low - extension - spacing, from.y(), netID, barrier) && \
+            barrier.first.x() < high + extension + spacing) {
+        return false;
+    }
+    BarrierSet_t *lines[] = {&_m2Hlines, &_m2Pads};
+    for (int i = 0; i < 2; ++i) {
+        BarrierSet_t::iterator it = lines[i]->upper_bound(from.y() - margin);
+        for (; it != lines[i]->end() && coord(it) < from.y() + margin; ++it) {
+            const line_t &edge = lineSeg(it);
+            if (it->second.first != netID && edge.first.x() < high + extension + spacing && \
+                    edge.second.x() > low - extension - spacing) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Create the wires of path, a via at every bend and a via at a contact
+// reached by a metal2 wire, as routeTwoContacts does for its corner points.
+void
+Router_t::commitPath(const RoutePath_t &path, oaInt4 netID)
+{
+    size_t last = path.size() - 1;
+    for (size_t i = 0; i < last; ++i) {
+        createWire(path[i], path[i + 1], netID);
+    }
+    for (size_t i = 1; i < last; ++i) {
+        createVia(path[i], netID);
+    }
+    if (path[0].y() == path[1].y()) {
+        createVia(path[0], netID);
+    }
+    if (path[last - 1].y() == path[last].y()) {
+        createVia(path[last], netID);
+    }
+}
+
+oaInt8
+Router_t::pathLength(const RoutePath_t &path)
+{
+    oaInt8 length = 0;
+    for (size_t i = 1; i < path.size(); ++i) {
+        length += abs(path[i].x() - path[i - 1].x()) + abs(path[i].y() - path[i - 1].y());
+    }
+    return length;
+}
+
+// createWire extends a wire by half a via and the via extension at both
+// ends
+oaInt8
+Router_t::wireLength(size_t first) const
+{
+    oaInt8 length = 0;
+    for (size_t i = first; i < _obstacles.size(); ++i) {
+        const oaBox &box = _obstacles[i].box;
+        if (METAL1 == _obstacles[i].layer) {
+            length += box.getHeight() - 2 * (_designRule.viaHeight() / 2) - \
+                2 * _designRule.viaExtension();
+        }
+        else {
+            length += box.getWidth() - 2 * (_designRule.viaWidth() / 2) - \
+                2 * _designRule.viaExtension();
+        }
+    }
+    return length;
+}
+
+// Free space for wire centre lines: the obstacles of the other nets grown
+// by the clearance segmentClear() checks, taken out of the routing region
+// shrunk by the same amount.
+void
+Router_t::clearanceBlocks(oaInt4 netID, vector<oaBox> &m1Blocks, oaBox &m1Area, \
+        vector<oaBox> &m2Blocks, oaBox &m2Area) const
+{
+    oaInt4 spacing = _designRule.metalSpacing();
+    oaInt4 halfWidth = _designRule.metalWidth() / 2;
+    oaInt4 m1Extension = _designRule.viaHeight() / 2 + _designRule.viaExtension();
+    oaInt4 m2Extension = _designRule.viaWidth() / 2 + _designRule.viaExtension();
+    oaBox region(_VDDBox.left(), _VSSBox.top(), _VSSBox.right(), _VDDBox.bottom());
+
+    m1Blocks.clear();
+    m2Blocks.clear();
+    vector<Obstacle_t>::const_iterator it;
+    for (it = _obstacles.begin(); it != _obstacles.end(); ++it) {
+        if (it->netID == netID || it->netID == -1) {
+            continue;
+        }
+        const oaBox &box = it->box;
+        if (it->layer == METAL1) {
+            m1Blocks.push_back(oaBox(box.left() - spacing - halfWidth, \
+                        box.bottom() - spacing - m1Extension, \
+                        box.right() + spacing + halfWidth, \
+                        box.top() + spacing + m1Extension));
+        }
+        else {
+            m2Blocks.push_back(oaBox(box.left() - spacing - m2Extension, \
+                        box.bottom() - spacing - halfWidth, \
+                        box.right() + spacing + m2Extension, \
+                        box.top() + spacing + halfWidth));
+        }
+    }
+    m1Area = oaBox(region.left() + spacing + halfWidth, \
+            region.bottom() + spacing + m1Extension, \
+            region.right() - spacing - halfWidth, \
+            region.top() - spacing - m1Extension);
+    m2Area = oaBox(region.left() + spacing + m2Extension, \
+            region.bottom() + spacing + halfWidth, \
+            region.right() - spacing - m2Extension, \
+            region.top() - spacing - halfWidth);
+}
+
+void
+Router_t::buildTilePlanes(oaInt4 netID)
+{
+    vector<oaBox> m1Blocks;
+    vector<oaBox> m2Blocks;
+    oaBox m1Area;
+    oaBox m2Area;
+    clearanceBlocks(netID, m1Blocks, m1Area, m2Blocks, m2Area);
+    _m1Tiles.build(m1Area, m1Blocks, VERTICAL);
+    _m2Tiles.build(m2Area, m2Blocks, HORIZONTAL);
+}
+
+bool
+Router_t::planTiles(const oaPoint &from, const oaPoint &to, oaInt4 netID, \
+        RoutePath_t &path, const CancelToken_t *cancel)
+{
+    buildTilePlanes(netID);
+    double viaCost = _designRule.viaWidth() + _designRule.metalSpacing();
+    return searchTiles(_m1Tiles, _m2Tiles, from, to, viaCost, path, cancel);
+}
+
+// A* over tiles. A metal1 tile holds vertical wires and a metal2 tile
+// horizontal ones, so a wire never leaves its tile and the only moves are
+// vias between overlapping tiles of the two layers. Every interval not
+// covered by an earlier visit of a tile is expanded, so a path is found
+// whenever the free space connects the contacts.
+bool
+Router_t::searchTiles(const TilePlane_t &m1Tiles, const TilePlane_t &m2Tiles, \
+        const oaPoint &from, const oaPoint &to, double viaCost, RoutePath_t &path, \
+        const CancelToken_t *cancel)
+{
+    const TilePlane_t *planes[2] = {&m1Tiles, &m2Tiles};
+    vector<vector<pair<oaCoord, oaCoord> > > seen[2];
+    seen[0].resize(m1Tiles.size());
+    seen[1].resize(m2Tiles.size());
+
+    vector<TileState_t> states;
+    TileQueue_t open;
+    // start on metal1, or on metal2 through a via on the contact
+    for (int layer = 0; layer < 2; ++layer) {
+        long tile = planes[layer]->find(from);
+        if (tile >= 0) {
+            TileState_t state;
+            state.layer = layer;
+            state.tile = tile;
+            state.low = state.high = (layer == 0) ? from.x() : from.y();
+            state.at = from;
+            state.cost = layer * viaCost;
+            state.parent = -1;
+            open.push(make_pair(state.cost + manhattan(from, to), states.size()));
+            states.push_back(state);
+        }
+    }
+
+    long goal = -1;
+    while (!open.empty() && goal < 0) {
+        if (cancel != NULL && cancel->cancelled()) {
+            return false;
+        }
+        long index = open.top().second;
+        open.pop();
+        TileState_t state = states[index];
+        vector<pair<oaCoord, oaCoord> > &visits = seen[state.layer][state.tile];
+        if (dominated(visits, state.low, state.high)) {
+            continue;
+        }
+        visits.push_back(make_pair(state.low, state.high));
+        const oaBox &tile = planes[state.layer]->tile(state.tile);
+        oaCoord fixed = (state.layer == 0) ? to.x() : to.y();
+        if (tile.contains(to) && state.low <= fixed && fixed <= state.high) {
+            goal = index;
+            break;
+        }
+
+        int other = 1 - state.layer;
+        for (size_t i = 0; i < planes[other]->size(); ++i) {
+            const oaBox &next = planes[other]->tile(i);
+            if (!tile.overlaps(next)) {
+                continue;
+            }
+            // the via lies in both tiles and on the wire of this one
+            TileState_t reached;
+            oaCoord xLow, xHigh, yLow, yHigh;
+            if (state.layer == 0) {
+                xLow = max(state.low, next.left());
+                xHigh = min(state.high, next.right());
+                yLow = reached.low = max(tile.bottom(), next.bottom());
+                yHigh = reached.high = min(tile.top(), next.top());
+            }
+            else {
+                yLow = max(state.low, next.bottom());
+                yHigh = min(state.high, next.top());
+                xLow = reached.low = max(tile.left(), next.left());
+                xHigh = reached.high = min(tile.right(), next.right());
+            }
+            if (xLow > xHigh || yLow > yHigh || \
+                    dominated(seen[other][i], reached.low, reached.high)) {
+                continue;
+            }
+            reached.layer = other;
+            reached.tile = i;
+            reached.at = oaPoint(clampCoord(state.at.x(), xLow, xHigh), \
+                    clampCoord(state.at.y(), yLow, yHigh));
+            reached.cost = state.cost + manhattan(state.at, reached.at) + viaCost;
+            reached.parent = index;
+            open.push(make_pair(reached.cost + manhattan(reached.at, to), states.size()));
+            states.push_back(reached);
+        }
+    }
+    if (goal < 0) {
+        return false;
+    }
+
+    // place the vias from the goal back: each lies on the wire of the tile
+    // after it, within the interval of the tile before it
+    path.clear();
+    path.push_back(to);
+    oaCoord fixed = (states[goal].layer == 0) ? to.x() : to.y();
+    for (long i = goal; states[i].parent >= 0; i = states[i].parent) {
+        const TileState_t &state = states[i];
+        const TileState_t &parent = states[state.parent];
+        const oaBox &tile = planes[state.layer]->tile(state.tile);
+        const oaPoint &last = path.back();
+        if (state.layer == 0) {
+            oaCoord y = clampCoord(last.y(), max(parent.low, tile.bottom()), \
+                    min(parent.high, tile.top()));
+            path.push_back(oaPoint(fixed, y));
+            fixed = y;
+        }
+        else {
+            oaCoord x = clampCoord(last.x(), max(parent.low, tile.left()), \
+                    min(parent.high, tile.right()));
+            path.push_back(oaPoint(x, fixed));
+            fixed = x;
+        }
+    }
+    path.push_back(from);
+    reverse(path.begin(), path.end());
+    simplifyPath(path);
+    return true;
+}
+
+// Gridded mode: tracks every metalWidth + metalSpacing through the first
+// contact; when the second one lies on them, route on the track grid.
+bool
+Router_t::planGrid(const oaPoint &from, const oaPoint &to, oaInt4 netID, \
+        RoutePath_t &path, const CancelToken_t *cancel)
+{
+    oaBox region(_VDDBox.left(), _VSSBox.top(), _VSSBox.right(), _VDDBox.bottom());
+    _grid.reset(region, from, _designRule.metalWidth() + _designRule.metalSpacing());
+    if (!_grid.onGrid(to)) {
+        return false;
+    }
+
+    vector<oaBox> m1Blocks;
+    vector<oaBox> m2Blocks;
+    oaBox m1Area;
+    oaBox m2Area;
+    clearanceBlocks(netID, m1Blocks, m1Area, m2Blocks, m2Area);
+    return searchGrid(_grid, m1Area, m1Blocks, m2Area, m2Blocks, from, to, path, cancel);
+}
+
+// grid has been reset through from and has to on it
+bool
+Router_t::searchGrid(TrackGrid_t &grid, const oaBox &m1Area, const vector<oaBox> &m1Blocks, \
+        const oaBox &m2Area, const vector<oaBox> &m2Blocks, const oaPoint &from, \
+        const oaPoint &to, RoutePath_t &path, const CancelToken_t *cancel)
+{
+    if (!grid.setFree(0, m1Area, m1Blocks) || !grid.setFree(1, m2Area, m2Blocks) || \
+            !grid.search(from, to, path, cancel)) {
+        return false;
+    }
+    simplifyPath(path);
+    return true;
+}
+
+// drop stacked vias and bends that do not turn
+void
+Router_t::simplifyPath(RoutePath_t &path)
+{
+    RoutePath_t simple;
+    for (size_t i = 0; i < path.size(); ++i) {
+        if (!simple.empty() && simple.back() == path[i]) {
+            continue;
+        }
+        if (simple.size() >= 2) {
+            const oaPoint &first = simple[simple.size() - 2];
+            const oaPoint &middle = simple.back();
+            if ((first.x() == middle.x() && middle.x() == path[i].x()) || \
+                    (first.y() == middle.y() && middle.y() == path[i].y())) {
+                simple.pop_back();
+            }
+        }
+        simple.push_back(path[i]);
+    }
+    path.swap(simple);
+}
+
 // escape algorithm
 bool
 Router_t::escape(EndPoint_t &src, EndPoint_t &dst, oaPoint &intersectionPoint)
 {
+    ++_probes;
+    ++_totalProbes;
+    ++_netStats->escapes;
+    ROUTER_TRACE_POINT(TRACE_ESCAPE, src.netID(), src.getObjectPoint(), src.orient());
+
+    // the object point does not move until a new escape point is found,
+    // so the covers are shared by both escape lines and Escape Process I
+    line_t covers[4];
+    coversAt(src.getObjectPoint(), src.netID(), covers);
+
     if ((src.orient() == HORIZONTAL) || (src.orient() == BOTH)) {
         line_t escapeLine;
-        getEscapeLine(src, HORIZONTAL, escapeLine);
+        getEscapeLine(src, HORIZONTAL, covers, escapeLine);
         // add escapeLine
         //
         // createWire(escapeLine.first, escapeLine.second, _designRule.metalWidth());
@@ -700,7 +1900,7 @@ Router_t::escape(EndPoint_t &src, EndPoint_t &dst, oaPoint &intersectionPoint)
     }
     if ((src.orient() == VERTICAL) || (src.orient() == BOTH)) {
         line_t escapeLine;
-        getEscapeLine(src, VERTICAL, escapeLine);
+        getEscapeLine(src, VERTICAL, covers, escapeLine);
         // add escapeLine
         //
         // createWire(escapeLine.first, escapeLine.second, _designRule.metalWidth());
@@ -713,7 +1913,7 @@ Router_t::escape(EndPoint_t &src, EndPoint_t &dst, oaPoint &intersectionPoint)
         }
     }
     // get escapePoint
-    if (!getEscapePointI(src)) {
+    if (!getEscapePointI(src, covers)) {
         bool intersectionFlag = false;
         bool escapeII = getEscapePointII(src, dst, intersectionFlag, intersectionPoint);
         if (intersectionFlag) {
@@ -732,13 +1932,24 @@ Router_t::escape(EndPoint_t &src, EndPoint_t &dst, oaPoint &intersectionPoint)
 void
 Router_t::getEscapeLine(const EndPoint_t &src, Orient_t orient, line_t &escapeLine)
 {
-    line_t leftCover, rightCover, bottomCover, topCover;
+    line_t covers[4];
+    coversAt(src.getObjectPoint(), src.netID(), covers, orient);
+    getEscapeLine(src, orient, covers, escapeLine);
+}
+
+// Same as above with the covers of the object point already known.
+void
+Router_t::getEscapeLine(const EndPoint_t &src, Orient_t orient, \
+        const line_t *covers, line_t &escapeLine)
+{
+    ROUTER_TRACE_LINES(TRACE_ESCAPE_LINE, src.netID(), src.getObjectPoint(), orient, 3, \
+            covers[orient == HORIZONTAL ? LEFT : BOTTOM], \
+            covers[orient == HORIZONTAL ? RIGHT : TOP]);
     if (orient == HORIZONTAL) {
-        line_t leftCover, rightCover;
-        getCover(src, LEFT, leftCover);
-        getCover(src, RIGHT, rightCover);
+        const line_t &leftCover = covers[LEFT];
+        const line_t &rightCover = covers[RIGHT];
         if (sameBox(leftCover, rightCover)) {
-            cout << "leftcover and right cover are in the same box." << endl;
+            DEBUG_LOG("leftcover and right cover are in the same box.");
             escapeLine.first = escapeLine.second = src.getObjectPoint();
             return;
         }
@@ -761,11 +1972,10 @@ Router_t::getEscapeLine(const EndPoint_t &src, Orient_t orient, line_t &escapeLi
         }
     }
     else if (orient == VERTICAL) {
-        line_t bottomCover, topCover;
-        getCover(src, BOTTOM, bottomCover);
-        getCover(src, TOP, topCover);
+        const line_t &bottomCover = covers[BOTTOM];
+        const line_t &topCover = covers[TOP];
         if (sameBox(bottomCover, topCover)) {
-            cout << "bottomcover and topcover are in the same box." << endl;
+            DEBUG_LOG("bottomcover and topcover are in the same box.");
             escapeLine.first = escapeLine.second = src.getObjectPoint();
             return;
         }
@@ -800,14 +2010,22 @@ Router_t::getEscapeLine(const EndPoint_t &src, Orient_t orient, line_t &escapeLi
 bool
 Router_t::getEscapePointI(EndPoint_t &src)
 {
-    // get covers
-    line_t bottomCover, topCover, leftCover, rightCover;
-    oaPoint objectPoint = src.getObjectPoint();
+    line_t covers[4];
+    coversAt(src.getObjectPoint(), src.netID(), covers);
+    return getEscapePointI(src, covers);
+}
 
-    getCover(src, BOTTOM, bottomCover);
-    getCover(src, TOP, topCover);
-    getCover(src, LEFT, leftCover);
-    getCover(src, RIGHT, rightCover);
+// Same as above with the covers of the object point already known.
+bool
+Router_t::getEscapePointI(EndPoint_t &src, const line_t *covers)
+{
+    ++_netStats->escapePointI;
+    ROUTER_TRACE_POINT(TRACE_ESCAPE_POINT_I, src.netID(), src.getObjectPoint(), src.orient());
+    line_t bottomCover = covers[BOTTOM];
+    line_t topCover = covers[TOP];
+    line_t leftCover = covers[LEFT];
+    line_t rightCover = covers[RIGHT];
+    oaPoint objectPoint = src.getObjectPoint();
 
     bool noHorizontalEscape = sameBox(leftCover, rightCover);
     bool noVerticalEscape  = sameBox(bottomCover, topCover);
@@ -1044,15 +2262,21 @@ bool
 Router_t::getEscapePointII(EndPoint_t &src, const EndPoint_t &dst, \
         bool &intersectionFlag, oaPoint &intersectionPoint)
 {
+    ++_netStats->escapePointII;
+    ROUTER_TRACE_POINT(TRACE_ESCAPE_POINT_II, src.netID(), src.getObjectPoint(), src.orient());
     vector<oaPoint> r;
     // get covers
-    line_t bottomCover, topCover, leftCover, rightCover;
+    line_t covers[4];
     oaPoint objectPoint = src.getObjectPoint();
 
-    getCover(src, BOTTOM, bottomCover);
-    getCover(src, TOP, topCover);
-    getCover(src, LEFT, leftCover);
-    getCover(src, RIGHT, rightCover);
+    coversAt(objectPoint, src.netID(), covers);
+    line_t &bottomCover = covers[BOTTOM];
+    line_t &topCover = covers[TOP];
+    line_t &leftCover = covers[LEFT];
+    line_t &rightCover = covers[RIGHT];
+    // covers of the trial point, shared by its escape line and Escape
+    // Process I on it
+    line_t trialCovers[4];
 
     bool noHorizontalEscape = sameBox(leftCover, rightCover);
     bool noVerticalEscape  = sameBox(bottomCover, topCover);
@@ -1078,6 +2302,10 @@ Router_t::getEscapePointII(EndPoint_t &src, const EndPoint_t &dst, \
     bool r1, r2, r3, r4; 
     r1 = r2 = r3 = r4 = true;
     while (r1 || r2 || r3 || r4) {
+        if (budgetExceeded()) {
+            // routeTwoContacts reports the failure
+            return false;
+        }
         for (int i = 0; i < r.size(); ++i) {
             switch (i) {
             case 0:
@@ -1088,7 +2316,8 @@ Router_t::getEscapePointII(EndPoint_t &src, const EndPoint_t &dst, \
                 else {
                     line_t escapeHline;
                     src.addEscapePoint(r[i]);
-                    getEscapeLine(src, HORIZONTAL, escapeHline);
+                    coversAt(r[i], src.netID(), trialCovers);
+                    getEscapeLine(src, HORIZONTAL, trialCovers, escapeHline);
                     if (dst.isIntersect(escapeHline, intersectionPoint)) {
                         // add this line
                         src.addHline(escapeHline);
@@ -1096,27 +2325,28 @@ Router_t::getEscapePointII(EndPoint_t &src, const EndPoint_t &dst, \
                         return true;
                     }
                     else {
-                        if (getEscapePointI(src)) {
+                        if (getEscapePointI(src, trialCovers)) {
                             intersectionFlag = false;
                             return true;
                         }
                         else {
                             // remove r[i] from escapePoints vector
                             src.removeEscapePoint();
-                            r[i] -= oaPoint(0, _designRule.minimumStep());
+                            r[i].y() = nextTrialCoord(src, dst, r[i], VERTICAL, -1);
                         }
                     }
                 }
                 break;
             case 1:
-                if (noHorizontalEscape || (rightCover.first.y() == _VDDBox.right()) || \
+                if (noHorizontalEscape || (rightCover.first.x() == _VDDBox.right()) || \
                         r[i].x() <= objectPoint.x()) {
                     r2 = false;
                 }
                 else {
                     line_t escapeVline;
                     src.addEscapePoint(r[i]);
-                    getEscapeLine(src, VERTICAL, escapeVline);
+                    coversAt(r[i], src.netID(), trialCovers);
+                    getEscapeLine(src, VERTICAL, trialCovers, escapeVline);
                     if (dst.isIntersect(escapeVline, intersectionPoint)) {
                         // add escapeVline
                         src.addVline(escapeVline);
@@ -1124,14 +2354,14 @@ Router_t::getEscapePointII(EndPoint_t &src, const EndPoint_t &dst, \
                         return true;
                     }
                     else {
-                        if (getEscapePointI(src)) {
+                        if (getEscapePointI(src, trialCovers)) {
                             intersectionFlag = false;
                             return true;
                         }
                         else {
                             // remove r[i] from escapePoints vector
                             src.removeEscapePoint();
-                            r[i] -= oaPoint(_designRule.minimumStep(), 0);
+                            r[i].x() = nextTrialCoord(src, dst, r[i], HORIZONTAL, -1);
                         }
                     }
                 }
@@ -1144,21 +2374,22 @@ Router_t::getEscapePointII(EndPoint_t &src, const EndPoint_t &dst, \
                 else {
                     line_t escapeHline;
                     src.addEscapePoint(r[i]);
-                    getEscapeLine(src, HORIZONTAL, escapeHline);
+                    coversAt(r[i], src.netID(), trialCovers);
+                    getEscapeLine(src, HORIZONTAL, trialCovers, escapeHline);
                     if (dst.isIntersect(escapeHline, intersectionPoint)) {
                         src.addHline(escapeHline);
                         intersectionFlag = true;
                         return true;
                     }
                     else {
-                        if (getEscapePointI(src)) {
+                        if (getEscapePointI(src, trialCovers)) {
                             intersectionFlag = false;
                             return true;
                         }
                         else {
                             // remove r[i] from escapePoints vector
                             src.removeEscapePoint();
-                            r[i] += oaPoint(0, _designRule.minimumStep());
+                            r[i].y() = nextTrialCoord(src, dst, r[i], VERTICAL, 1);
                         }
                     }
                 }
@@ -1171,22 +2402,22 @@ Router_t::getEscapePointII(EndPoint_t &src, const EndPoint_t &dst, \
                 else {
                     line_t escapeVline;
                     src.addEscapePoint(r[i]);
-                    getEscapeLine(src, VERTICAL, escapeVline);
-                    oaPoint intersectionPoint;
+                    coversAt(r[i], src.netID(), trialCovers);
+                    getEscapeLine(src, VERTICAL, trialCovers, escapeVline);
                     if (dst.isIntersect(escapeVline, intersectionPoint)) {
                         src.addVline(escapeVline);
                         intersectionFlag = true;
                         return true;
                     }
                     else {
-                        if (getEscapePointI(src)) {
+                        if (getEscapePointI(src, trialCovers)) {
                             intersectionFlag = false;
                             return true;
                         }
                         else {
                             // remove r[i] from escapePoints vector
                             src.removeEscapePoint();
-                            r[i] -= oaPoint(_designRule.minimumStep(), 0);
+                            r[i].x() = nextTrialCoord(src, dst, r[i], HORIZONTAL, 1);
                         }
                     }
                 }
@@ -1196,11 +2427,60 @@ Router_t::getEscapePointII(EndPoint_t &src, const EndPoint_t &dst, \
             } 
         }
     } 
+    // all trial points are exhausted
+    return false;
+}
+
+// Move a trial point of Escape Process II along orient in direction dir.
+// Its covers, escape lines and the escape points Escape Process I finds
+// from it only change where the point crosses a barrier, a widened
+// barrier span or an escape line bound of src or dst, so the point jumps
+// to the nearest such event instead of stepping through the stretch in
+// between. It still moves at least one minimum step, as before.
+oaCoord
+Router_t::nextTrialCoord(const EndPoint_t &src, const EndPoint_t &dst, \
+        const oaPoint &point, Orient_t orient, int dir)
+{
+    oaInt4 step = _designRule.minimumStep();
+    oaCoord pos = (orient == VERTICAL) ? point.y() : point.x();
+    const BarrierIndex_t &along = (orient == VERTICAL) ? _m1Barriers : _m2Barriers;
+    const BarrierIndex_t &across = (orient == VERTICAL) ? _m2Barriers : _m1Barriers;
+    // the trial point stops once it passes the object point
+    oaCoord nearest = (orient == VERTICAL) ? src.getObjectPoint().y() : \
+                      src.getObjectPoint().x();
+
+    // Escape Process I also probes one minimum step away from the trial
+    // point, so events are looked up from pos and pos +- step
+    for (int shift = -1; shift <= 1; ++shift) {
+        oaCoord from = pos + shift * step;
+        oaCoord event;
+        if (along.nextCoord(from, dir, event) && \
+                dir * (event - shift * step - nearest) < 0) {
+            nearest = event - shift * step;
+        }
+        if (across.nextSpanBound(from, dir, event) && \
+                dir * (event - shift * step - nearest) < 0) {
+            nearest = event - shift * step;
+        }
+        if (src.nextLineBound(from, orient, dir, event) && \
+                dir * (event - shift * step - nearest) < 0) {
+            nearest = event - shift * step;
+        }
+        if (dst.nextLineBound(from, orient, dir, event) && \
+                dir * (event - shift * step - nearest) < 0) {
+            nearest = event - shift * step;
+        }
+    }
+
+    oaCoord next = pos + dir * step;
+    return (dir * (nearest - next) > 0) ? nearest : next;
 }
 
 void
 Router_t::createWire(const oaPoint &lhs, const oaPoint &rhs, oaInt4 netID)
 {
+    ROUTER_TRACE_LINES(TRACE_WIRE, netID, lhs, lhs.x() == rhs.x() ? VERTICAL : HORIZONTAL, \
+            1, line_t(lhs, rhs), line_t(lhs, rhs));
     oaInt4 width = _designRule.metalWidth();
     if (lhs != rhs) {
         if (lhs.x() == rhs.x()) {
@@ -1228,7 +2508,7 @@ Router_t::createWire(const oaPoint &lhs, const oaPoint &rhs, oaInt4 netID)
             }
             oaBox wirebox(wireleft, wirebottom, wireright, wiretop);
 
-            oaRect::create(_design->getTopBlock(), METAL1, 1, wirebox);
+            createRect(METAL1, netID, wirebox);
             // add wirebox as obstacle
             addObstacle(METAL1, netID, wirebox);
 
@@ -1254,7 +2534,7 @@ Router_t::createWire(const oaPoint &lhs, const oaPoint &rhs, oaInt4 netID)
                             _designRule.viaExtension();
             }
             oaBox wirebox(wireleft, wirebottom, wireright, wiretop);
-            oaRect::create(_design->getTopBlock(), METAL2, 1, wirebox);
+            createRect(METAL2, netID, wirebox);
             // add wirebox as obstacle 
             addObstacle(METAL2, netID, wirebox);
         }
@@ -1270,108 +2550,171 @@ Router_t::createWire(const oaPoint &lhs, const oaPoint &rhs, oaInt4 netID)
 }
 
 void
-Router_t::createVia(const oaPoint &point)
+Router_t::createVia(const oaPoint &point, oaInt4 netID)
 {
+    ++_netStats->vias;
     oaCoord left, right, bottom, top;
     left = point.x() - _designRule.viaWidth() / 2;
     right = point.x() + _designRule.viaWidth() / 2;
     bottom = point.y() - _designRule.viaHeight() / 2;
     top = point.y() + _designRule.viaHeight() / 2;
 
-    oaRect::create(_design->getTopBlock(), VIA1, 1, oaBox(left, bottom, right, top));
+    _journal.addRect(VIA_SHAPE, netID, VIA1, oaBox(left, bottom, right, top));
 }
 
 void
-Router_t::getCover(const EndPoint_t &src, CoverType type, line_t &cover)
+Router_t::coversAt(const oaPoint &point, oaInt4 netID, line_t *covers, \
+        Orient_t orient)
 {
-    BarrierSet_t::iterator lineIter;
-    oaPoint objectPoint = src.getObjectPoint();
+    ++_netStats->coverQueries;
 
-    switch (type) {
-    case LEFT:
-        lineIter = _m2Barriers.lower_bound(objectPoint.x());
-        do {
-            --lineIter;
-            if (netID(lineIter) == src.netID()) {
-                continue; 
-            }
-            oaInt4 ylow = lineSeg(lineIter).first.y() - \
-                          _designRule.metalSpacing() - \
-                          _designRule.metalWidth() / 2;
+    if (orient == HORIZONTAL || orient == BOTH) {
+        _m2Barriers.findAround(point.x(), point.y(), netID, covers[LEFT], \
+                covers[RIGHT]);
+        ROUTER_TRACE_LINES(TRACE_COVER, netID, point, HORIZONTAL, 3, \
+                covers[LEFT], covers[RIGHT]);
+    }
+    if (orient == VERTICAL || orient == BOTH) {
+        _m1Barriers.findAround(point.y(), point.x(), netID, covers[BOTTOM], \
+                covers[TOP]);
+        ROUTER_TRACE_LINES(TRACE_COVER, netID, point, VERTICAL, 3, \
+                covers[BOTTOM], covers[TOP]);
+    }
+}
 
-            oaInt4 yhigh = lineSeg(lineIter).second.y() + \
-                           _designRule.metalSpacing() + \
-                           _designRule.metalWidth() / 2;
+// journal a routed wire rectangle
+void
+Router_t::createRect(oaLayerNum layer, oaInt4 netID, const oaBox &box)
+{
+    ++_netStats->wires;
+    _journal.addRect(WIRE_SHAPE, netID, layer, box);
+}
 
-            if (ylow < objectPoint.y() && objectPoint.y() < yhigh) {
-                cover = lineSeg(lineIter);
-                return;
-            }
-        } while (lineIter != _m2Barriers.begin());
-        break;
-    case RIGHT:
-        lineIter = _m2Barriers.upper_bound(objectPoint.x());
-        for (; lineIter != _m2Barriers.end(); ++lineIter) {
-            if (netID(lineIter) == src.netID()) {
-                continue;
-            }
-            oaInt4 ylow = lineSeg(lineIter).first.y() - \
-                          _designRule.metalSpacing() - \
-                          _designRule.metalWidth() / 2;
+Router_t::Savepoint_t
+Router_t::savepoint() const
+{
+    Savepoint_t point;
+    point.shapes = _journal.savepoint();
+    point.obstacles = _obstacles.size();
+    point.m1Barriers = _m1Barriers;
+    point.m2Barriers = _m2Barriers;
+    point.m1Vlines = _m1Vlines;
+    point.m2Hlines = _m2Hlines;
+    point.m2Pads = _m2Pads;
+    return point;
+}
+
+// Undo the shapes and obstacles created after point, in O(changes): the
+// barrier sets go back to the snapshots in point.
+void
+Router_t::rollback(const Savepoint_t &point)
+{
+    _journal.rollback(point.shapes);
+    _obstacles.resize(point.obstacles);
+    _m1Barriers = point.m1Barriers;
+    _m2Barriers = point.m2Barriers;
+    _m1Vlines = point.m1Vlines;
+    _m2Hlines = point.m2Hlines;
+    _m2Pads = point.m2Pads;
+}
 
-            oaInt4 yhigh = lineSeg(lineIter).second.y() + \
-                           _designRule.metalSpacing() + \
-                           _designRule.metalWidth() / 2;
+// flush the journal into the backend
+void
+Router_t::commit()
+{
+    double start = wallTime();
+    _journal.flush(*_backend);
+    _stats.addPhase("commit", wallTime() - start);
+}
 
-            if (ylow < objectPoint.y() && objectPoint.y() < yhigh) {
-                cover = lineSeg(lineIter);
-                return;
-            }
-        }
-        break;
-    case BOTTOM:
-        lineIter = _m1Barriers.lower_bound(objectPoint.y());
-        do {
-            --lineIter;
-            if (netID(lineIter) == src.netID()) {
-                continue; 
-            }
-            oaInt4 xlow = lineSeg(lineIter).first.x() - \
-                          _designRule.metalSpacing() - \
-                          _designRule.metalWidth() / 2;
+// escape points created by the escape process of a connection, the
+// endpoints start with one each
+void
+Router_t::countEscapePoints(const EndPoint_t &lhs, const EndPoint_t &rhs)
+{
+    _netStats->escapePoints += lhs.escapePoints().size() + rhs.escapePoints().size() - 2;
+}
 
-            oaInt4 xhigh = lineSeg(lineIter).second.x() + \
-                           _designRule.metalSpacing() + \
-                           _designRule.metalWidth() / 2;
+// add the metal1 boxes of the contacts of net as obstacles
+void
+Router_t::addContactObstacles(const Net_t &net)
+{
+    Net_t::const_iterator citer;
+    for (citer = net.begin(); citer != net.end(); ++citer) {
+        oaPoint upperRight(citer->x() + _designRule.viaWidth(), \
+                citer->y() + _designRule.viaHeight());
+
+        oaBox m1Box(*citer, upperRight);
+        m1Box.bottom() -= _designRule.viaExtension();
+        m1Box.top() += _designRule.viaExtension();
+        addObstacle(METAL1, net.id(), m1Box);
+    }
+}
 
-            if (xlow < objectPoint.x() && objectPoint.x() < xhigh) {
-                cover = lineSeg(lineIter);
-                return;
-            }
-        } while (lineIter != _m1Barriers.begin());
-        break;
-    case TOP:
-        lineIter = _m1Barriers.upper_bound(objectPoint.y());
-        for (; lineIter != _m1Barriers.end(); ++lineIter) {
-            if (netID(lineIter) == src.netID()) {
-                continue; 
-            }
-            oaInt4 xlow = lineSeg(lineIter).first.x() - \
-                          _designRule.metalSpacing() - \
-                          _designRule.metalWidth() / 2;
-
-            oaInt4 xhigh = lineSeg(lineIter).second.x() + \
-                           _designRule.metalSpacing() + \
-                           _designRule.metalWidth() / 2;
-            if (xlow < objectPoint.x() && objectPoint.x() < xhigh) {
-                cover = lineSeg(lineIter);
-                return;
-            }
+// add the metal2 a wire ending on each contact of net would cover with
+// its via extension, see createWire
+void
+Router_t::addContactPads(const Net_t &net)
+{
+    oaInt4 width = _designRule.metalWidth();
+    oaInt4 extension = _designRule.viaWidth() / 2 + _designRule.viaExtension();
+    Net_t::const_iterator citer;
+    for (citer = net.begin(); citer != net.end(); ++citer) {
+        oaPoint centre(citer->x() + _designRule.viaWidth() / 2, \
+                citer->y() + _designRule.viaHeight() / 2);
+        line_t bottomEdge(oaPoint(centre.x() - extension, centre.y() - width / 2), \
+                oaPoint(centre.x() + extension, centre.y() - width / 2));
+        line_t topEdge(oaPoint(centre.x() - extension, centre.y() + width / 2), \
+                oaPoint(centre.x() + extension, centre.y() + width / 2));
+        _m2Pads.insert(make_pair(bottomEdge.first.y(), make_pair(net.id(), bottomEdge)));
+        _m2Pads.insert(make_pair(topEdge.first.y(), make_pair(net.id(), topEdge)));
+    }
+}
+
+// Journal the routed shapes cached for this cell and make its wires
+// obstacles, as if the nets had been routed.
+bool
+Router_t::replayCached()
+{
+    RouteCache_t::makeKey(_nets, _designRule, _VDDBox, _VSSBox, _cacheKey);
+    vector<ShapeJournal_t::Shape_t> shapes;
+    if (!_cache->load(_cacheKey, shapes)) {
+        return false;
+    }
+    vector<ShapeJournal_t::Shape_t>::const_iterator it;
+    for (it = shapes.begin(); it != shapes.end(); ++it) {
+        if (it->kind == LABEL_SHAPE) {
+            _journal.addLabel(it->netID, it->layer, it->box.lowerLeft(), it->label);
         }
-        break;
-    default:
-        cerr << "Invalid cover type!" << endl;
-        exit(1);
+        else if (it->kind == WIRE_SHAPE) {
+            createRect(it->layer, it->netID, it->box);
+            addObstacle(it->layer, it->netID, it->box);
+        }
+        else if (it->kind == VIA_SHAPE) {
+            ++_netStats->vias;
+            _journal.addRect(VIA_SHAPE, it->netID, it->layer, it->box);
+        }
+    }
+    DEBUG_LOG("Replayed " << shapes.size() << " cached shapes");
+    return true;
+}
+
+// store the routed shapes, the contacts come from the connection file
+void
+Router_t::storeCached()
+{
+    if (_cache == NULL) {
+        return;
+    }
+    vector<ShapeJournal_t::Shape_t> shapes;
+    ShapeJournal_t::const_iterator it;
+    for (it = _journal.begin(); it != _journal.end(); ++it) {
+        if (it->kind != CONTACT_SHAPE) {
+            shapes.push_back(*it);
+        }
+    }
+    if (!_cache->store(_cacheKey, shapes)) {
+        WARN_LOG("Cannot write the route cache entry of this cell");
     }
 }
 
@@ -1392,25 +2735,50 @@ Router_t::addObstacle(oaLayerNum layer, oaInt4 netID, const oa::oaBox &box)
 
 
     if (METAL1 == layer) {
-        _m1Barriers.insert(make_pair(box.bottom(), make_pair(netID, bottomEdge)));
-        _m1Barriers.insert(make_pair(box.top(), make_pair(netID, topEdge)));
-        _m1Vlines.insert(make_pair(box.left(), make_pair(netID, leftEdge)));
-        _m1Vlines.insert(make_pair(box.right(), make_pair(netID, rightEdge)));
+        _m1Barriers.insert(box.bottom(), box.left(), box.right(), netID, bottomEdge);
+        _m1Barriers.insert(box.top(), box.left(), box.right(), netID, topEdge);
     }
     else if (METAL2 == layer) {
-        _m2Barriers.insert(make_pair(box.left(), make_pair(netID, leftEdge)));
-        _m2Barriers.insert(make_pair(box.right(), make_pair(netID, rightEdge)));
-        _m2Hlines.insert(make_pair(box.bottom(), make_pair(netID, bottomEdge)));
-        _m2Hlines.insert(make_pair(box.top(), make_pair(netID, topEdge)));
+        _m2Barriers.insert(box.left(), box.bottom(), box.top(), netID, leftEdge);
+        _m2Barriers.insert(box.right(), box.bottom(), box.top(), netID, rightEdge);
     }
     else {
         cerr << "Invalid layer!" << endl;
         exit(1);
     }
+    addLines(layer, netID, box);
+
+    Obstacle_t obstacle;
+    obstacle.layer = layer;
+    obstacle.netID = netID;
+    obstacle.box = box;
+    _obstacles.push_back(obstacle);
+}
+
+// add the edges of box used by sameBox
+void
+Router_t::addLines(oaLayerNum layer, oaInt4 netID, const oaBox &box)
+{
+    if (METAL1 == layer) {
+        line_t leftEdge(oaPoint(box.left(), box.bottom()), \
+                oaPoint(box.left(), box.top()));
+        line_t rightEdge(oaPoint(box.right(), box.bottom()), \
+                oaPoint(box.right(), box.top()));
+        _m1Vlines.insert(make_pair(box.left(), make_pair(netID, leftEdge)));
+        _m1Vlines.insert(make_pair(box.right(), make_pair(netID, rightEdge)));
+    }
+    else {
+        line_t bottomEdge(oaPoint(box.left(), box.bottom()), \
+                oaPoint(box.right(), box.bottom()));
+        line_t topEdge(oaPoint(box.left(), box.top()), \
+                oaPoint(box.right(), box.top()));
+        _m2Hlines.insert(make_pair(box.bottom(), make_pair(netID, bottomEdge)));
+        _m2Hlines.insert(make_pair(box.top(), make_pair(netID, topEdge)));
+    }
 }
 
 bool
-Router_t::sameBox(line_t &lhs, line_t &rhs)
+Router_t::sameBox(const line_t &lhs, const line_t &rhs)
 {
     if (lhs.first.x() == rhs.first.x() && lhs.second.x() == rhs.second.x()) {
         // horizontal lines 
@@ -1436,6 +2804,39 @@ Router_t::sameBox(line_t &lhs, line_t &rhs)
             }
         }
     }
-    
+    // a box with an edge on one cover that reaches past the other, its own
+    // far edge hidden behind a nearer barrier (a wire running into a rail)
+    if (lhs.first.y() == lhs.second.y() && rhs.first.y() == rhs.second.y()) {
+        return reachesPast(_m1Vlines, lhs, rhs, true);
+    }
+    if (lhs.first.x() == lhs.second.x() && rhs.first.x() == rhs.second.x()) {
+        return reachesPast(_m2Hlines, lhs, rhs, false);
+    }
+    return false;
+}
+
+// true if a box of lines has lhs or rhs as an edge and spans from lhs to
+// rhs, the covers being horizontal (M1) or vertical (M2)
+bool
+Router_t::reachesPast(BarrierSet_t &lines, const line_t &lhs, const line_t &rhs, \
+        bool horizontal)
+{
+    oaCoord low = horizontal ? lhs.first.y() : lhs.first.x();
+    oaCoord high = horizontal ? rhs.first.y() : rhs.first.x();
+    const line_t *covers[2] = {&lhs, &rhs};
+    for (int i = 0; i < 2; ++i) {
+        // the box edges are keyed by their low end across the covers
+        oaCoord key = horizontal ? covers[i]->first.x() : covers[i]->first.y();
+        pair<BarrierSet_t::iterator, BarrierSet_t::iterator> ret = lines.equal_range(key);
+        for (BarrierSet_t::iterator it = ret.first; it != ret.second; ++it) {
+            const line_t &edge = lineSeg(it);
+            oaCoord edgeLow = horizontal ? edge.first.y() : edge.first.x();
+            oaCoord edgeHigh = horizontal ? edge.second.y() : edge.second.x();
+            if (netID(it) != -1 && edgeLow <= low && edgeHigh >= high && \
+                    (i == 0 ? edgeLow == low : edgeHigh == high)) {
+                return true;
+            }
+        }
+    }
     return false;
 }
@@ -2,56 +2,265 @@
 #define ROUTER_H_
 
 #include <vector>
-#include "oaDesignDB.h"
+#include "Geometry.h"
 #include "Net.h"
 #include "NetSet.h"
 #include "DRC.h"
 #include "EndPoint.h"
+#include "BarrierIndex.h"
+#include "FlatMap.h"
+#include "ShapeJournal.h"
+#include "LayoutBackend.h"
+#include "RouterStats.h"
+#include "TilePlane.h"
+#include "TrackGrid.h"
+#include "RouteCache.h"
+#include "CancelToken.h"
 
 class Router_t {
 public:
-    Router_t(oa::oaDesign *design, oa::oaTech *tech, std::ifstream &file1,\
-            std::ifstream &file2);
+    // Engine_t: what connects two contacts no pattern route can join:
+    // line probing, an A* search over the free tiles of both layers, line
+    // probing with the tile search when probing gives up, a wavefront on
+    // the track grid when both contacts are on it, else line probing, or
+    // the three of them racing on their own threads (see setRaceGrace)
+    typedef enum { PROBE_ENGINE, TILE_ENGINE, FALLBACK_ENGINE, GRID_ENGINE, \
+        RACE_ENGINE } Engine_t;
+
+    // file1: connection file, file2: design rule file; malformed files
+    // throw a ParseError_t
+    Router_t(LayoutBackend_t &backend, std::ifstream &file1, std::ifstream &file2);
+    Router_t(LayoutBackend_t &backend, const char *connectionFile, const char *ruleFile);
+    Router_t(LayoutBackend_t &backend, const NetSet_t &nets, const DRC_t &designRule);
     bool route();
     bool reRoute();
-private:
-    typedef enum { LEFT, BOTTOM, RIGHT, TOP } CoverType;
+    // rip up and reroute only the nets that failed in route()
+    bool rerouteFailedNets();
+    // limit the work spent on one connection: number of escape() probes
+    // and wall-clock seconds, 0 means no limit. A router starts with
+    // DEFAULT_MAX_PROBES and DEFAULT_MAX_SECONDS.
+    void setProbeBudget(oa::oaUInt4 maxProbes, double maxSeconds);
+    static const oa::oaUInt4 DEFAULT_MAX_PROBES = 10000;
+    static const double DEFAULT_MAX_SECONDS;
+    const std::vector<ConnectionFailure_t> &failures() const { return _failures; }
+    // escape() calls over all connections routed so far
+    oa::oaUInt8 totalProbes() const { return _totalProbes; }
+    // try L and Z shaped routes before line probing (default on)
+    void setPatternRouting(bool enable) { _patternRouting = enable; }
+    void setEngine(Engine_t engine) { _engine = engine; }
+    // engine by name: "probe", "tile", "fallback", "grid" or "race"
+    static bool parseEngine(const char *name, Engine_t &engine);
+    // look the cell up in cache before routing and store it there once
+    // routed; cached() tells whether route() replayed a cached result
+    void setCache(RouteCache_t *cache) { _cache = cache; }
+    bool cached() const { return _cached; }
+    // portfolio mode: once VDD and VSS are routed, route the other nets
+    // in workers orderings at once, each on its own copy of the router,
+    // and keep the best result; 0 or 1 routes the one ordering of
+    // reorderNets
+    void setPortfolio(unsigned workers) { _portfolio = workers; }
+    // race engine: once the first engine finds a path, wait up to seconds
+    // for the others and keep the shortest path (default 0, the first)
+    void setRaceGrace(double seconds) { _raceGrace = seconds; }
+    // connections routed so far, and how many of them by a pattern
+    oa::oaUInt8 connections() const { return _connections; }
+    oa::oaUInt8 patternRoutes() const { return _patternRoutes; }
+    static const char *failReasonName(FailReason_t reason);
+    // phase times and per-net counters, see RouterStats.h
+    RouterStats_t &stats() { return _stats; }
+    const RouterStats_t &stats() const { return _stats; }
+    // number of contacts to connect, a cost estimate for scheduling
+    size_t contactCount() const { return _nets.contactCount(); }
+
     // BarrierSet_t: containters for storing line barriers, 
     // used in line-probing algorithm
-    typedef std::multimap<oa::oaCoord, std::pair<oa::oaInt4, line_t> > BarrierSet_t;
+    typedef FlatMultimap_t<oa::oaCoord, std::pair<oa::oaInt4, line_t> > BarrierSet_t;
+    // Savepoint_t: state of the journal and the obstacles, rollback()
+    // undoes everything created after it. The barrier sets are snapshots
+    // sharing their sorted parts with the router's, so taking and keeping
+    // a savepoint costs the barriers inserted since the last merge only.
+    typedef struct {
+        size_t shapes;
+        size_t obstacles;
+        BarrierIndex_t m1Barriers;
+        BarrierIndex_t m2Barriers;
+        BarrierSet_t m1Vlines;
+        BarrierSet_t m2Hlines;
+        BarrierSet_t m2Pads;
+    } Savepoint_t;
+    Savepoint_t savepoint() const;
+    void rollback(const Savepoint_t &point);
+    // write the journaled shapes into the backend
+    void commit();
+private:
+    // bench/microbench.cpp times the private primitives directly, the
+    // checks in tests/ call them
+    friend class RouterBench_t;
+    friend class RouterCheck_t;
+
+    typedef enum { LEFT, BOTTOM, RIGHT, TOP } CoverType;
+    // BarrierOfNet: predicate selecting the barriers of one net
+    class BarrierOfNet {
+    public:
+        BarrierOfNet(oa::oaInt4 netID) : _netID(netID) {}
+        bool operator()(const BarrierSet_t::value_type &barrier) const {
+            return barrier.second.first == _netID;
+        }
+    private:
+        oa::oaInt4 _netID;
+    };
+    // NetKeys_t: a sort key and a position in _nets for each net to order
+    typedef std::vector<std::pair<oa::oaInt8, size_t> > NetKeys_t;
+    // RoutePath_t: centre line of a route from one contact to another,
+    // consecutive points differ in x or in y only
+    typedef std::vector<oa::oaPoint> RoutePath_t;
+    // Obstacle_t: an obstacle in the order it was added
+    typedef struct {
+        oa::oaLayerNum layer;
+        oa::oaInt4 netID;
+        oa::oaBox box;
+    } Obstacle_t;
     
     void reorderNets();
+    // put the net at keys[i].second to position first + i
+    void permuteNets(const NetKeys_t &keys, size_t first);
+    // route the nets at positions [first, last), failed ones go to
+    // _failedNets
+    bool routeNets(size_t first, size_t last);
+    // ordering heuristic of portfolio worker worker for the nets after
+    // VDD and VSS, see orderingName()
+    void orderNets(unsigned worker);
+    static const char *orderingName(unsigned worker);
+    bool routePortfolio();
+    static void portfolioWorker(size_t job, void *context);
     bool routeOneNet(const Net_t &net);
     bool routeVDD(const Net_t &net);
     bool routeVSS(const Net_t &net);
     bool routeSignal(const Net_t &net);
     bool routeIO(const Net_t &net);
     void createWire(const oa::oaPoint &lhs, const oa::oaPoint &rhs, oa::oaInt4 netID);
-    void createVia(const oa::oaPoint &point);
+    void createVia(const oa::oaPoint &point, oa::oaInt4 netID);
+    void createRect(oa::oaLayerNum layer, oa::oaInt4 netID, const oa::oaBox &box);
     bool routeTwoContacts(EndPoint_t &lhs, EndPoint_t &rhs);
+    // the engines of _engine in turn, or racing for RACE_ENGINE
+    bool engineTwoContacts(EndPoint_t &lhs, EndPoint_t &rhs);
+    bool raceTwoContacts(EndPoint_t &lhs, EndPoint_t &rhs);
+    static void *raceWorker(void *arg);
+    bool probeTwoContacts(EndPoint_t &lhs, EndPoint_t &rhs);
+    // pattern routing: planPattern finds the first legal straight, L or Z
+    // route between two contact centres, commitPath creates it
+    bool planPattern(const oa::oaPoint &from, const oa::oaPoint &to, oa::oaInt4 netID, \
+            RoutePath_t &path);
+    bool pathClear(const RoutePath_t &path, oa::oaInt4 netID);
+    bool segmentClear(const oa::oaPoint &from, const oa::oaPoint &to, oa::oaInt4 netID);
+    void commitPath(const RoutePath_t &path, oa::oaInt4 netID);
+    // centre line length of path, and of the wires created since obstacle
+    // first, the same measure for a path commitPath created
+    static oa::oaInt8 pathLength(const RoutePath_t &path);
+    oa::oaInt8 wireLength(size_t first) const;
+    // tile engine: build the tile planes of the other nets' obstacles and
+    // search them for a path of metal1 verticals and metal2 horizontals
+    bool planTiles(const oa::oaPoint &from, const oa::oaPoint &to, oa::oaInt4 netID, \
+            RoutePath_t &path, const CancelToken_t *cancel=NULL);
+    void buildTilePlanes(oa::oaInt4 netID);
+    void clearanceBlocks(oa::oaInt4 netID, std::vector<oa::oaBox> &m1Blocks, \
+            oa::oaBox &m1Area, std::vector<oa::oaBox> &m2Blocks, oa::oaBox &m2Area) const;
+    // the searches of planTiles and planGrid, on planes and a grid of
+    // their own while racing
+    static bool searchTiles(const TilePlane_t &m1Tiles, const TilePlane_t &m2Tiles, \
+            const oa::oaPoint &from, const oa::oaPoint &to, double viaCost, \
+            RoutePath_t &path, const CancelToken_t *cancel);
+    static bool searchGrid(TrackGrid_t &grid, const oa::oaBox &m1Area, \
+            const std::vector<oa::oaBox> &m1Blocks, const oa::oaBox &m2Area, \
+            const std::vector<oa::oaBox> &m2Blocks, const oa::oaPoint &from, \
+            const oa::oaPoint &to, RoutePath_t &path, const CancelToken_t *cancel);
+    // gridded mode, see TrackGrid.h
+    bool planGrid(const oa::oaPoint &from, const oa::oaPoint &to, oa::oaInt4 netID, \
+            RoutePath_t &path, const CancelToken_t *cancel=NULL);
+    static void simplifyPath(RoutePath_t &path);
     // escape: perform escape algorithm
     bool escape(EndPoint_t &src, EndPoint_t &dst, oa::oaPoint &intersectionPoint);
     void getEscapeLine(const EndPoint_t &src, Orient_t orient, line_t &escapeLine);
-    bool getEscapePointI(EndPoint_t &src); 
+    void getEscapeLine(const EndPoint_t &src, Orient_t orient, const line_t *covers, \
+            line_t &escapeLine);
+    bool getEscapePointI(EndPoint_t &src);
+    bool getEscapePointI(EndPoint_t &src, const line_t *covers);
     bool getEscapePointII(EndPoint_t &src, const EndPoint_t &dst, bool &intersectionFlag, \
             oa::oaPoint &intersectionPoint);
-    void getCover(const EndPoint_t &src, CoverType type, line_t &cover);
+    oa::oaCoord nextTrialCoord(const EndPoint_t &src, const EndPoint_t &dst, \
+            const oa::oaPoint &point, Orient_t orient, int dir);
+    // coversAt: get the covers of point in one pass, covers is indexed by
+    // CoverType; orient restricts the query to LEFT/RIGHT (HORIZONTAL)
+    // or BOTTOM/TOP (VERTICAL)
+    void coversAt(const oa::oaPoint &point, oa::oaInt4 netID, line_t *covers, \
+            Orient_t orient=BOTH);
+    bool budgetExceeded();
+    void countEscapePoints(const EndPoint_t &lhs, const EndPoint_t &rhs);
+    void addContactObstacles(const Net_t &net);
+    void addContactPads(const Net_t &net);
+    bool replayCached();
+    void storeCached();
+    void ripUpNet(oa::oaInt4 netID);
+    const Net_t *findNet(oa::oaInt4 netID) const;
+    void init();
+    void initObstacles();
     void addObstacle(oa::oaLayerNum layer, oa::oaInt4 netID, const oa::oaBox &box);
-    bool sameBox(line_t &lhs, line_t &rhs);
+    void addLines(oa::oaLayerNum layer, oa::oaInt4 netID, const oa::oaBox &box);
+    bool sameBox(const line_t &lhs, const line_t &rhs);
+    bool reachesPast(BarrierSet_t &lines, const line_t &lhs, const line_t &rhs, \
+            bool horizontal);
 
-    line_t &lineSeg(const BarrierSet_t::iterator &it) {return (it->second).second;}
+    const line_t &lineSeg(const BarrierSet_t::iterator &it) {return (it->second).second;}
     oa::oaInt4 netID(const BarrierSet_t::iterator &it) {return (it->second).first;}
     oa::oaCoord coord(const BarrierSet_t::iterator &it) {return it->first;}
 
-    oa::oaDesign *_design;
-    oa::oaTech *_tech;
+    LayoutBackend_t *_backend;
     oa::oaBox _VDDBox;
     oa::oaBox _VSSBox;
     NetSet_t _nets;
     DRC_t _designRule;
-    BarrierSet_t _m1Barriers;
+    // horizontal M1 edges keyed by y, vertical M2 edges keyed by x
+    BarrierIndex_t _m1Barriers;
     BarrierSet_t _m1Vlines;
-    BarrierSet_t _m2Barriers;
+    BarrierIndex_t _m2Barriers;
     BarrierSet_t _m2Hlines;
+    // horizontal edges of the metal2 a via on each contact would need,
+    // keyed by y: a pattern route must leave room for it
+    BarrierSet_t _m2Pads;
+
+    // per-connection budget of routeTwoContacts
+    oa::oaUInt4 _maxProbes;
+    double _maxSeconds;
+    oa::oaUInt4 _probes;
+    oa::oaUInt8 _totalProbes;
+    bool _patternRouting;
+    oa::oaUInt8 _connections;
+    oa::oaUInt8 _patternRoutes;
+    Engine_t _engine;
+    // free space for wire centre lines, rebuilt by buildTilePlanes
+    TilePlane_t _m1Tiles;
+    TilePlane_t _m2Tiles;
+    TrackGrid_t _grid;
+    RouteCache_t *_cache;
+    RouteCache_t::Key_t _cacheKey;
+    bool _cached;
+    unsigned _portfolio;
+    double _raceGrace;
+    // polled by budgetExceeded while line probing races other engines
+    const CancelToken_t *_cancel;
+    double _deadline;
+    FailReason_t _failReason;
+    std::vector<ConnectionFailure_t> _failures;
+
+    // shapes not yet written to the design and the obstacle log, both
+    // undone by rollback
+    ShapeJournal_t _journal;
+    std::vector<Obstacle_t> _obstacles;
+    Savepoint_t _initial;
+    std::vector<oa::oaInt4> _failedNets;
+
+    RouterStats_t _stats;
+    // counters of the net being routed, _stats.other() between nets
+    NetStats_t *_netStats;
 };
 #endif
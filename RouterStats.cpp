@@ -0,0 +1,180 @@
+#include <cstdio>
+#include <algorithm>
+#include "RouterStats.h"
+
+using namespace oa;
+using namespace std;
+
+static const char *
+netTypeName(NetType_t type)
+{
+    switch (type) {
+    case VDD:
+        return "VDD";
+    case VSS:
+        return "VSS";
+    case S:
+        return "S";
+    case IO:
+        return "IO";
+    }
+    return "NULL";
+}
+
+// names of FailReason_t in the report
+static const char *failureKeys[] = {"none", "noEscape", "probeLimit", "timeLimit", \
+    "noPath"};
+
+// value at fraction q of sorted
+static double
+percentile(const vector<double> &sorted, double q)
+{
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t index = static_cast<size_t>(q * (sorted.size() - 1) + 0.5);
+    return sorted[index];
+}
+
+RouterStats_t::RouterStats_t()
+    : _phases(), _nets(), _latencies()
+{
+    clearNet(_other, -1, S);
+}
+
+void
+RouterStats_t::clearNet(NetStats_t &stats, oaInt4 netID, NetType_t type)
+{
+    stats.netID = netID;
+    stats.type = type;
+    stats.attempts = 0;
+    stats.seconds = 0;
+    stats.connections = 0;
+    stats.patternRoutes = 0;
+    stats.tileRoutes = 0;
+    stats.gridRoutes = 0;
+    stats.escapes = 0;
+    stats.escapePointI = 0;
+    stats.escapePointII = 0;
+    stats.coverQueries = 0;
+    stats.escapePoints = 0;
+    stats.cornerPoints = 0;
+    stats.wires = 0;
+    stats.vias = 0;
+    for (int i = NO_FAILURE; i <= NO_PATH; ++i) {
+        stats.failures[i] = 0;
+    }
+}
+
+void
+RouterStats_t::addPhase(const string &name, double seconds)
+{
+    vector<pair<string, double> >::iterator it;
+    for (it = _phases.begin(); it != _phases.end(); ++it) {
+        if (it->first == name) {
+            it->second += seconds;
+            return;
+        }
+    }
+    _phases.push_back(make_pair(name, seconds));
+}
+
+// net ids are the positions of the nets in the connection file
+NetStats_t &
+RouterStats_t::net(oaInt4 netID, NetType_t type)
+{
+    while (_nets.size() <= static_cast<size_t>(netID)) {
+        NetStats_t stats;
+        clearNet(stats, _nets.size(), S);
+        _nets.push_back(stats);
+    }
+    _nets[netID].type = type;
+    return _nets[netID];
+}
+
+void
+RouterStats_t::writeString(ostream &os, const string &str)
+{
+    os << '"';
+    for (size_t i = 0; i < str.size(); ++i) {
+        unsigned char c = str[i];
+        if (c == '"' || c == '\\') {
+            os << '\\' << c;
+        }
+        else if (c < 0x20) {
+            char buffer[8];
+            sprintf(buffer, "\\u%04x", c);
+            os << buffer;
+        }
+        else {
+            os << c;
+        }
+    }
+    os << '"';
+}
+
+void
+RouterStats_t::writeJson(ostream &os, int indent) const
+{
+    string pad(indent, ' ');
+    os << pad << "\"phases\": {";
+    for (size_t i = 0; i < _phases.size(); ++i) {
+        os << (i ? ", " : "");
+        writeString(os, _phases[i].first);
+        os << ": " << _phases[i].second;
+    }
+    os << "}," << endl;
+
+    os << pad << "\"nets\": [";
+    for (size_t i = 0; i < _nets.size(); ++i) {
+        const NetStats_t &stats = _nets[i];
+        os << (i ? "," : "") << endl << pad << "  {";
+        os << "\"id\": " << stats.netID;
+        os << ", \"type\": \"" << netTypeName(stats.type) << "\"";
+        os << ", \"attempts\": " << stats.attempts;
+        os << ", \"seconds\": " << stats.seconds;
+        os << ", \"connections\": " << stats.connections;
+        os << ", \"patternRoutes\": " << stats.patternRoutes;
+        os << ", \"tileRoutes\": " << stats.tileRoutes;
+        os << ", \"gridRoutes\": " << stats.gridRoutes;
+        os << ", \"escapes\": " << stats.escapes;
+        os << ", \"escapePointI\": " << stats.escapePointI;
+        os << ", \"escapePointII\": " << stats.escapePointII;
+        os << ", \"coverQueries\": " << stats.coverQueries;
+        os << ", \"escapePoints\": " << stats.escapePoints;
+        os << ", \"cornerPoints\": " << stats.cornerPoints;
+        os << ", \"wires\": " << stats.wires;
+        os << ", \"vias\": " << stats.vias;
+        os << ", \"failures\": {";
+        for (int reason = NO_ESCAPE; reason <= NO_PATH; ++reason) {
+            os << (reason > NO_ESCAPE ? ", " : "") << "\"" << failureKeys[reason];
+            os << "\": " << stats.failures[reason];
+        }
+        os << "}}";
+    }
+    os << endl << pad << "]," << endl;
+
+    // share of the connections that took the pattern fast path
+    oaUInt8 connections = 0;
+    oaUInt8 patternRoutes = 0;
+    for (size_t i = 0; i < _nets.size(); ++i) {
+        connections += _nets[i].connections;
+        patternRoutes += _nets[i].patternRoutes;
+    }
+    os << pad << "\"connections\": " << connections;
+    os << ", \"patternRoutes\": " << patternRoutes;
+    os << ", \"patternFraction\": ";
+    os << (connections ? static_cast<double>(patternRoutes) / connections : 0) << "," << endl;
+
+    // seconds per connection past the pattern routes, where the engines
+    // and their races spend the time
+    vector<double> sorted(_latencies);
+    sort(sorted.begin(), sorted.end());
+    os << pad << "\"latency\": {\"connections\": " << sorted.size();
+    os << ", \"p50\": " << percentile(sorted, 0.5) << ", \"p90\": " << percentile(sorted, 0.9);
+    os << ", \"p99\": " << percentile(sorted, 0.99);
+    os << ", \"max\": " << (sorted.empty() ? 0 : sorted.back()) << "}," << endl;
+
+    os << pad << "\"other\": {\"escapes\": " << _other.escapes;
+    os << ", \"coverQueries\": " << _other.coverQueries << "}" << endl;
+}
@@ -0,0 +1,65 @@
+// The class RouterStats_t collects where a Router_t spends its time: wall
+// time per phase and per connection left to the engines and, per net, how
+// often the line-probing steps ran and what they produced. writeJson()
+// emits it for offline analysis.
+#ifndef ROUTERSTATS_H_
+#define ROUTERSTATS_H_
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <ostream>
+#include "Geometry.h"
+#include "RouterType.h"
+
+// NetStats_t: counters of one net, summed over all its routing attempts
+typedef struct {
+    oa::oaInt4 netID;
+    NetType_t type;
+    oa::oaUInt4 attempts;
+    double seconds;
+    // routeTwoContacts calls, and those routed by an L or Z pattern
+    oa::oaUInt4 connections;
+    oa::oaUInt4 patternRoutes;
+    // connections routed by the tile engine and on the track grid
+    oa::oaUInt4 tileRoutes;
+    oa::oaUInt4 gridRoutes;
+    oa::oaUInt8 escapes;
+    oa::oaUInt8 escapePointI;
+    oa::oaUInt8 escapePointII;
+    oa::oaUInt8 coverQueries;
+    oa::oaUInt8 escapePoints;
+    oa::oaUInt8 cornerPoints;
+    oa::oaUInt4 wires;
+    oa::oaUInt4 vias;
+    // indexed by FailReason_t
+    oa::oaUInt4 failures[NO_PATH + 1];
+} NetStats_t;
+
+class RouterStats_t {
+public:
+    RouterStats_t();
+    // add seconds to the named phase, phases keep their first-seen order
+    void addPhase(const std::string &name, double seconds);
+    // stats of net netID, created on first use
+    NetStats_t &net(oa::oaInt4 netID, NetType_t type);
+    // counters of work done outside of any net
+    NetStats_t &other() { return _other; }
+    // wall time of one connection no pattern route could join
+    void addLatency(double seconds) { _latencies.push_back(seconds); }
+    const std::vector<double> &latencies() const { return _latencies; }
+
+    // write {"phases": {...}, "nets": [...]} at the given indentation
+    void writeJson(std::ostream &os, int indent) const;
+    // write str as a quoted JSON string
+    static void writeString(std::ostream &os, const std::string &str);
+private:
+    static void clearNet(NetStats_t &stats, oa::oaInt4 netID, NetType_t type);
+
+    std::vector<std::pair<std::string, double> > _phases;
+    std::vector<NetStats_t> _nets;
+    NetStats_t _other;
+    std::vector<double> _latencies;
+};
+
+#endif
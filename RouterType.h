@@ -4,7 +4,7 @@
 #include <utility>
 #include <vector>
 #include <map>
-#include "oaDesignDB.h"
+#include "Geometry.h"
 #include "line.h"
 
 
@@ -17,4 +17,16 @@ typedef enum {HORIZONTAL, VERTICAL, BOTH} Orient_t;
 
 typedef enum {VDD, VSS, S, IO} NetType_t;
 
+// FailReason_t: why routeTwoContacts gave up on a connection, NO_PATH is
+// reported by the tile engine
+typedef enum {NO_FAILURE, NO_ESCAPE, PROBE_LIMIT, TIME_LIMIT, NO_PATH} FailReason_t;
+
+// ConnectionFailure_t: a connection that could not be routed
+typedef struct {
+    oa::oaInt4 netID;
+    oa::oaPoint from;
+    oa::oaPoint to;
+    FailReason_t reason;
+} ConnectionFailure_t;
+
 #endif
@@ -0,0 +1,130 @@
+#include <algorithm>
+#include <iostream>
+#include <cstdlib>
+#include <unistd.h>
+#include "Scheduler.h"
+
+using namespace std;
+
+// order job indices by decreasing cost
+class CostGreater {
+public:
+    CostGreater(const vector<double> &costs) : _costs(costs) {}
+    bool operator()(size_t lhs, size_t rhs) const {
+        return _costs[lhs] > _costs[rhs];
+    }
+private:
+    const vector<double> &_costs;
+};
+
+Scheduler_t::Scheduler_t(unsigned threads)
+    : _threads(threads), _workers(), _task(NULL), _context(NULL)
+{
+    if (_threads == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        _threads = (online > 0) ? online : 1;
+    }
+    for (unsigned i = 0; i < _threads; ++i) {
+        Worker_t *worker = new Worker_t;
+        pthread_mutex_init(&worker->lock, NULL);
+        _workers.push_back(worker);
+    }
+}
+
+Scheduler_t::~Scheduler_t()
+{
+    for (unsigned i = 0; i < _threads; ++i) {
+        pthread_mutex_destroy(&_workers[i]->lock);
+        delete _workers[i];
+    }
+}
+
+void
+Scheduler_t::run(const vector<double> &costs, Task_t task, void *context)
+{
+    _task = task;
+    _context = context;
+
+    // deal the jobs longest-first, so every deque is sorted by cost and
+    // the expensive jobs start before the cheap ones
+    vector<size_t> order(costs.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    stable_sort(order.begin(), order.end(), CostGreater(costs));
+    for (size_t i = 0; i < order.size(); ++i) {
+        _workers[i % _threads]->jobs.push_back(order[i]);
+    }
+
+    // the calling thread is worker 0
+    vector<pthread_t> handles(_threads);
+    vector<Start_t> starts(_threads);
+    for (unsigned i = 1; i < _threads; ++i) {
+        starts[i].scheduler = this;
+        starts[i].self = i;
+        if (pthread_create(&handles[i], NULL, threadMain, &starts[i]) != 0) {
+            cerr << "Cannot create thread." << endl;
+            exit(1);
+        }
+    }
+    work(0);
+    for (unsigned i = 1; i < _threads; ++i) {
+        pthread_join(handles[i], NULL);
+    }
+}
+
+void *
+Scheduler_t::threadMain(void *arg)
+{
+    Start_t *start = static_cast<Start_t *>(arg);
+    start->scheduler->work(start->self);
+    return NULL;
+}
+
+// Jobs never spawn jobs, so a thread that finds every deque empty is done.
+void
+Scheduler_t::work(unsigned self)
+{
+    size_t job;
+    while (popOwn(self, job) || steal(self, job)) {
+        _task(job, _context);
+    }
+}
+
+bool
+Scheduler_t::popOwn(unsigned self, size_t &job)
+{
+    Worker_t *worker = _workers[self];
+    bool found = false;
+    pthread_mutex_lock(&worker->lock);
+    if (!worker->jobs.empty()) {
+        job = worker->jobs.front();
+        worker->jobs.pop_front();
+        found = true;
+    }
+    pthread_mutex_unlock(&worker->lock);
+    return found;
+}
+
+// take the most expensive job left of the first victim that has one: a
+// long job started late is what stretches the run, the cheap ones at the
+// back are left to their own thread
+bool
+Scheduler_t::steal(unsigned self, size_t &job)
+{
+    for (unsigned i = 1; i < _threads; ++i) {
+        Worker_t *victim = _workers[(self + i) % _threads];
+        bool found = false;
+        pthread_mutex_lock(&victim->lock);
+        if (!victim->jobs.empty()) {
+            job = victim->jobs.front();
+            victim->jobs.pop_front();
+            found = true;
+        }
+        pthread_mutex_unlock(&victim->lock);
+        if (found) {
+            return true;
+        }
+    }
+    return false;
+}
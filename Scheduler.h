@@ -0,0 +1,47 @@
+// The class Scheduler_t runs independent jobs on a pool of threads. Jobs
+// are dealt longest-first to per-thread deques; a thread takes the next
+// job from the front of its own deque and, once it runs dry, steals the
+// front (most expensive) job of another.
+#ifndef SCHEDULER_H_
+#define SCHEDULER_H_
+
+#include <vector>
+#include <deque>
+#include <pthread.h>
+
+class Scheduler_t {
+public:
+    // Task_t: routine run for each job index, context is passed through
+    typedef void (*Task_t)(size_t job, void *context);
+
+    // threads == 0 uses one thread per online processor
+    Scheduler_t(unsigned threads);
+    ~Scheduler_t();
+    unsigned threads() const { return _threads; }
+
+    // run task for every job in [0, costs.size()), costs[i] estimates the
+    // work of job i; returns when all jobs are done
+    void run(const std::vector<double> &costs, Task_t task, void *context);
+private:
+    // Worker_t: job queue of one thread
+    struct Worker_t {
+        pthread_mutex_t lock;
+        std::deque<size_t> jobs;
+    };
+    struct Start_t {
+        Scheduler_t *scheduler;
+        unsigned self;
+    };
+
+    static void *threadMain(void *arg);
+    void work(unsigned self);
+    bool popOwn(unsigned self, size_t &job);
+    bool steal(unsigned self, size_t &job);
+
+    unsigned _threads;
+    std::vector<Worker_t *> _workers;
+    Task_t _task;
+    void *_context;
+};
+
+#endif
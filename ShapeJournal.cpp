@@ -0,0 +1,201 @@
+#include <vector>
+#include <algorithm>
+#include "ShapeJournal.h"
+
+using namespace oa;
+using namespace std;
+
+// order rectangles by layer and net so each group is contiguous
+class LayerNetLess {
+public:
+    bool operator()(const ShapeJournal_t::Shape_t &lhs, \
+            const ShapeJournal_t::Shape_t &rhs) const {
+        if (lhs.layer != rhs.layer) {
+            return lhs.layer < rhs.layer;
+        }
+        return lhs.netID < rhs.netID;
+    }
+};
+
+static bool
+bottomLess(const oaBox &lhs, const oaBox &rhs)
+{
+    return lhs.bottom() < rhs.bottom();
+}
+
+// Scanline union of boxes into non-overlapping rectangles. Every slab
+// between two consecutive y coordinates is cut into maximal x intervals,
+// overlapping or abutting boxes join. An interval continuing unchanged
+// into the next slab extends the open rectangle instead of starting a new
+// one.
+static void
+unionBoxes(vector<oaBox> &boxes, vector<oaBox> &merged)
+{
+    vector<oaCoord> ys;
+    vector<oaBox>::const_iterator it;
+    for (it = boxes.begin(); it != boxes.end(); ++it) {
+        ys.push_back(it->bottom());
+        ys.push_back(it->top());
+    }
+    sort(ys.begin(), ys.end());
+    ys.erase(unique(ys.begin(), ys.end()), ys.end());
+    sort(boxes.begin(), boxes.end(), bottomLess);
+
+    // active: boxes reaching into the current slab
+    // open: rectangles not closed yet, their top is still unknown
+    vector<oaBox> active;
+    vector<oaBox> open;
+    vector<pair<oaCoord, oaCoord> > spans;
+    size_t next = 0;
+    for (size_t i = 0; i + 1 < ys.size(); ++i) {
+        oaCoord bottom = ys[i];
+        oaCoord top = ys[i + 1];
+        size_t kept = 0;
+        for (size_t j = 0; j < active.size(); ++j) {
+            if (active[j].top() > bottom) {
+                active[kept++] = active[j];
+            }
+        }
+        active.resize(kept);
+        while (next < boxes.size() && boxes[next].bottom() == bottom) {
+            active.push_back(boxes[next++]);
+        }
+
+        spans.clear();
+        for (size_t j = 0; j < active.size(); ++j) {
+            spans.push_back(make_pair(active[j].left(), active[j].right()));
+        }
+        sort(spans.begin(), spans.end());
+        size_t count = 0;
+        for (size_t j = 0; j < spans.size(); ++j) {
+            if (count > 0 && spans[j].first <= spans[count - 1].second) {
+                spans[count - 1].second = max(spans[count - 1].second, spans[j].second);
+            }
+            else {
+                spans[count++] = spans[j];
+            }
+        }
+        spans.resize(count);
+
+        // close the open rectangles whose interval ends here, both lists
+        // are sorted by left
+        vector<oaBox> stillOpen;
+        size_t k = 0;
+        for (size_t j = 0; j < open.size(); ++j) {
+            while (k < spans.size() && spans[k].first < open[j].left()) {
+                stillOpen.push_back(oaBox(spans[k].first, bottom, spans[k].second, top));
+                ++k;
+            }
+            if (k < spans.size() && spans[k].first == open[j].left() && \
+                    spans[k].second == open[j].right()) {
+                open[j].top() = top;
+                stillOpen.push_back(open[j]);
+                ++k;
+            }
+            else {
+                merged.push_back(open[j]);
+            }
+        }
+        for (; k < spans.size(); ++k) {
+            stillOpen.push_back(oaBox(spans[k].first, bottom, spans[k].second, top));
+        }
+        open.swap(stillOpen);
+    }
+    merged.insert(merged.end(), open.begin(), open.end());
+}
+
+void
+ShapeJournal_t::addRect(ShapeKind_t kind, oaInt4 netID, oaLayerNum layer, \
+        const oaBox &box)
+{
+    Shape_t shape;
+    shape.kind = kind;
+    shape.netID = netID;
+    shape.layer = layer;
+    shape.box = box;
+    _shapes.push_back(shape);
+}
+
+void
+ShapeJournal_t::addLabel(oaInt4 netID, oaLayerNum layer, const oaPoint &origin, \
+        const oaString &label)
+{
+    Shape_t shape;
+    shape.kind = LABEL_SHAPE;
+    shape.netID = netID;
+    shape.layer = layer;
+    shape.box = oaBox(origin, origin);
+    shape.label = label;
+    _shapes.push_back(shape);
+}
+
+void
+ShapeJournal_t::rollback(size_t savepoint)
+{
+    if (savepoint < _flushed) {
+        savepoint = _flushed;
+    }
+    if (savepoint < _shapes.size()) {
+        _shapes.resize(savepoint);
+    }
+}
+
+void
+ShapeJournal_t::eraseRouted(oaInt4 netID)
+{
+    // flushed shapes are already in the design and stay in the journal
+    vector<Shape_t> kept(_shapes.begin(), _shapes.begin() + _flushed);
+    vector<Shape_t>::const_iterator it;
+    for (it = _shapes.begin() + _flushed; it != _shapes.end(); ++it) {
+        if (it->netID != netID || it->kind == CONTACT_SHAPE) {
+            kept.push_back(*it);
+        }
+    }
+    _shapes.swap(kept);
+}
+
+// Rectangles of the same layer and net are merged before they are
+// created, labels are created as they are.
+size_t
+ShapeJournal_t::flush(LayoutBackend_t &backend)
+{
+    size_t created = 0;
+    vector<Shape_t> rects;
+    vector<Shape_t>::const_iterator it;
+    for (it = _shapes.begin() + _flushed; it != _shapes.end(); ++it) {
+        if (it->kind == LABEL_SHAPE) {
+            backend.createLabel(it->layer, it->box.lowerLeft(), it->label);
+            ++created;
+        }
+        else if (it->box.left() < it->box.right() && it->box.bottom() < it->box.top()) {
+            rects.push_back(*it);
+        }
+    }
+    stable_sort(rects.begin(), rects.end(), LayerNetLess());
+
+    vector<oaBox> boxes;
+    vector<oaBox> merged;
+    vector<Shape_t>::const_iterator first = rects.begin();
+    while (first != rects.end()) {
+        vector<Shape_t>::const_iterator last = first;
+        boxes.clear();
+        for (; last != rects.end() && last->layer == first->layer && \
+                last->netID == first->netID; ++last) {
+            boxes.push_back(last->box);
+        }
+        merged.clear();
+        unionBoxes(boxes, merged);
+        if (merged.size() > boxes.size()) {
+            // crossing wires are cut into more pieces than they started as
+            merged.swap(boxes);
+        }
+        vector<oaBox>::const_iterator boxIter;
+        for (boxIter = merged.begin(); boxIter != merged.end(); ++boxIter) {
+            backend.createRect(first->layer, *boxIter);
+        }
+        created += merged.size();
+        first = last;
+    }
+    _flushed = _shapes.size();
+    return created;
+}
@@ -0,0 +1,51 @@
+// The class ShapeJournal_t records the shapes created while routing a
+// cell. Nothing is written to the layout until flush(), so routing
+// attempts can be undone by rolling back to a savepoint.
+#ifndef SHAPEJOURNAL_H_
+#define SHAPEJOURNAL_H_
+
+#include <vector>
+#include "Geometry.h"
+#include "LayoutBackend.h"
+
+typedef enum {CONTACT_SHAPE, WIRE_SHAPE, VIA_SHAPE, LABEL_SHAPE} ShapeKind_t;
+
+class ShapeJournal_t {
+public:
+    // Shape_t: one journaled shape, a label is placed at box.lowerLeft()
+    typedef struct {
+        ShapeKind_t kind;
+        oa::oaInt4 netID;
+        oa::oaLayerNum layer;
+        oa::oaBox box;
+        oa::oaString label;
+    } Shape_t;
+    typedef std::vector<Shape_t>::const_iterator const_iterator;
+
+    ShapeJournal_t() : _shapes(), _flushed(0) {}
+    void addRect(ShapeKind_t kind, oa::oaInt4 netID, oa::oaLayerNum layer, \
+            const oa::oaBox &box);
+    void addLabel(oa::oaInt4 netID, oa::oaLayerNum layer, const oa::oaPoint &origin, \
+            const oa::oaString &label);
+
+    // a savepoint is the number of shapes recorded so far
+    size_t savepoint() const { return _shapes.size(); }
+    // drop the shapes recorded after savepoint, flushed shapes are kept
+    void rollback(size_t savepoint);
+    // drop the routed shapes of a net, its contacts are kept
+    void eraseRouted(oa::oaInt4 netID);
+
+    const_iterator begin() const { return _shapes.begin(); }
+    const_iterator end() const { return _shapes.end(); }
+    size_t size() const { return _shapes.size(); }
+
+    // create the shapes recorded since the last flush in backend, overlapping
+    // and abutting rectangles of the same layer and net are merged first;
+    // returns the number of shapes created
+    size_t flush(LayoutBackend_t &backend);
+private:
+    std::vector<Shape_t> _shapes;
+    size_t _flushed;
+};
+
+#endif
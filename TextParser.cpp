@@ -0,0 +1,198 @@
+#include <sstream>
+#include <iterator>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "TextParser.h"
+
+using namespace oa;
+using namespace std;
+
+ParseError_t::ParseError_t(const string &fileName, unsigned line, unsigned column, \
+        const string &message)
+    : runtime_error(format(fileName, line, column, message)), _fileName(fileName), \
+      _line(line), _column(column)
+{
+}
+
+string
+ParseError_t::format(const string &fileName, unsigned line, unsigned column, \
+        const string &message)
+{
+    ostringstream text;
+    text << fileName << ":";
+    if (line != 0) {
+        text << line << ":" << column << ":";
+    }
+    text << " " << message;
+    return text.str();
+}
+
+MappedFile_t::MappedFile_t(const char *fileName)
+    : _name(fileName), _data(""), _size(0), _mapped(NULL)
+{
+    int fd = open(fileName, O_RDONLY);
+    if (fd < 0) {
+        throw ParseError_t(_name, 0, 0, string("cannot open: ") + strerror(errno));
+    }
+    struct stat status;
+    if (fstat(fd, &status) == 0 && S_ISREG(status.st_mode) && status.st_size > 0) {
+        void *mapped = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped != MAP_FAILED) {
+            _mapped = mapped;
+            _data = static_cast<const char *>(mapped);
+            _size = status.st_size;
+            madvise(mapped, _size, MADV_SEQUENTIAL);
+        }
+    }
+    // not a regular file or not mappable: read it
+    while (_mapped == NULL) {
+        char block[65536];
+        ssize_t count = read(fd, block, sizeof(block));
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count < 0) {
+            int error = errno;
+            close(fd);
+            throw ParseError_t(_name, 0, 0, string("cannot read: ") + strerror(error));
+        }
+        if (count == 0) {
+            break;
+        }
+        _buffer.insert(_buffer.end(), block, block + count);
+    }
+    close(fd);
+    if (_mapped == NULL && !_buffer.empty()) {
+        _data = &_buffer[0];
+        _size = _buffer.size();
+    }
+}
+
+MappedFile_t::MappedFile_t(istream &file, const char *name)
+    : _name(name), _data(""), _size(0), _mapped(NULL)
+{
+    file.clear();
+    file.seekg(0, ios::end);
+    streamoff length = file.tellg();
+    file.seekg(0);
+    if (length > 0) {
+        _buffer.resize(length);
+        file.read(&_buffer[0], length);
+        _buffer.resize(file.gcount());
+    }
+    else if (length < 0) {
+        // not seekable
+        file.clear();
+        _buffer.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+    }
+    if (!_buffer.empty()) {
+        _data = &_buffer[0];
+        _size = _buffer.size();
+    }
+}
+
+MappedFile_t::~MappedFile_t()
+{
+    if (_mapped != NULL) {
+        munmap(_mapped, _size);
+    }
+}
+
+TextScanner_t::TextScanner_t(const MappedFile_t &file)
+    : _file(file), _pos(file.begin()), _lineStart(file.begin()), _line(1)
+{
+}
+
+void
+TextScanner_t::skipBlanks()
+{
+    while (_pos != _file.end() && isBlank(*_pos)) {
+        ++_pos;
+    }
+}
+
+bool
+TextScanner_t::atLineEnd()
+{
+    skipBlanks();
+    return _pos == _file.end() || *_pos == '\n';
+}
+
+bool
+TextScanner_t::atInteger()
+{
+    skipBlanks();
+    const char *digit = _pos;
+    if (digit != _file.end() && (*digit == '-' || *digit == '+')) {
+        ++digit;
+    }
+    return digit != _file.end() && *digit >= '0' && *digit <= '9';
+}
+
+// scanned by hand: strtol would need a terminated copy of the token
+oaInt4
+TextScanner_t::integer(const char *expected)
+{
+    const char *first;
+    const char *last;
+    if (!atInteger()) {
+        token(expected, first, last);
+        fail(first, string("expected ") + expected + ", found '" + string(first, last) + "'");
+    }
+    const char *end = _file.end();
+    const char *digit = _pos;
+    bool negative = (*digit == '-');
+    if (*digit == '-' || *digit == '+') {
+        ++digit;
+    }
+    const unsigned long long limit = negative ? 2147483648ULL : 2147483647ULL;
+    unsigned long long value = 0;
+    for (; digit != end && *digit >= '0' && *digit <= '9'; ++digit) {
+        value = value * 10 + (*digit - '0');
+        if (value > limit) {
+            fail(_pos, string(expected) + " out of range");
+        }
+    }
+    if (digit != end && !isBlank(*digit) && *digit != '\n') {
+        token(expected, first, last);
+        fail(first, string("expected ") + expected + ", found '" + string(first, last) + "'");
+    }
+    _pos = digit;
+    return static_cast<oaInt4>(negative ? -static_cast<long long>(value) : value);
+}
+
+void
+TextScanner_t::token(const char *expected, const char *&first, const char *&last)
+{
+    if (atLineEnd()) {
+        fail(_pos, string("expected ") + expected + ", found end of line");
+    }
+    first = _pos;
+    while (_pos != _file.end() && !isBlank(*_pos) && *_pos != '\n') {
+        ++_pos;
+    }
+    last = _pos;
+}
+
+void
+TextScanner_t::endLine()
+{
+    if (!atLineEnd()) {
+        fail(_pos, "expected end of line");
+    }
+    if (_pos != _file.end()) {
+        ++_pos;
+        _lineStart = _pos;
+        ++_line;
+    }
+}
+
+void
+TextScanner_t::fail(const char *where, const string &message) const
+{
+    throw ParseError_t(_file.name(), _line, where - _lineStart + 1, message);
+}
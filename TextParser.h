@@ -0,0 +1,83 @@
+// Reading of the connection and design rule files: MappedFile_t maps a
+// file into memory, TextScanner_t walks it line by line and scans its
+// integers in place, ParseError_t reports where the text went wrong.
+#ifndef TEXTPARSER_H_
+#define TEXTPARSER_H_
+#include <string>
+#include <vector>
+#include <istream>
+#include <stdexcept>
+#include "Geometry.h"
+
+// what() reads "file:line:column: message", or "file: message" when the
+// file could not be read at all (line 0)
+class ParseError_t : public std::runtime_error {
+public:
+    ParseError_t(const std::string &fileName, unsigned line, unsigned column, \
+            const std::string &message);
+    ~ParseError_t() throw() {}
+    const std::string &fileName() const { return _fileName; }
+    unsigned line() const { return _line; }
+    unsigned column() const { return _column; }
+private:
+    static std::string format(const std::string &fileName, unsigned line, unsigned column, \
+            const std::string &message);
+    std::string _fileName;
+    unsigned _line;
+    unsigned _column;
+};
+
+// The contents of a file, mapped read-only. Files that cannot be mapped
+// (pipes) and streams are read into a buffer instead.
+class MappedFile_t {
+public:
+    explicit MappedFile_t(const char *fileName);
+    // the whole of file, name is used in the errors only
+    MappedFile_t(std::istream &file, const char *name);
+    ~MappedFile_t();
+
+    const std::string &name() const { return _name; }
+    const char *begin() const { return _data; }
+    const char *end() const { return _data + _size; }
+    size_t size() const { return _size; }
+private:
+    MappedFile_t(const MappedFile_t &);
+    MappedFile_t &operator=(const MappedFile_t &);
+    std::string _name;
+    const char *_data;
+    size_t _size;
+    void *_mapped;              // NULL unless _data is mapped
+    std::vector<char> _buffer;
+};
+
+// Tokens are separated by blanks (space, tab, carriage return), lines by
+// '\n'. Nothing is copied: tokens are returned as ranges of the file.
+class TextScanner_t {
+public:
+    explicit TextScanner_t(const MappedFile_t &file);
+
+    bool atEnd() const { return _pos == _file.end(); }
+    // skips blanks, true at the end of the line or of the file
+    bool atLineEnd();
+    // skips blanks, true if the next token starts like an integer
+    bool atInteger();
+    // the next token as a decimal integer, expected names it in the error
+    oa::oaInt4 integer(const char *expected);
+    // the next token, which must exist, as [first, last)
+    void token(const char *expected, const char *&first, const char *&last);
+    // moves to the next line, the rest of this one must be blank
+    void endLine();
+
+    unsigned line() const { return _line; }
+    // throws a ParseError_t at where, a position on the current line
+    void fail(const char *where, const std::string &message) const;
+private:
+    static bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+    void skipBlanks();
+    const MappedFile_t &_file;
+    const char *_pos;
+    const char *_lineStart;
+    unsigned _line;
+};
+
+#endif
@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <utility>
+#include "TilePlane.h"
+
+using namespace oa;
+using namespace std;
+
+static oaBox
+transpose(const oaBox &box)
+{
+    return oaBox(box.bottom(), box.left(), box.top(), box.right());
+}
+
+void
+TilePlane_t::build(const oaBox &region, const vector<oaBox> &blocks, Orient_t orient)
+{
+    _tiles.clear();
+    if (orient == HORIZONTAL) {
+        buildStrips(region, blocks);
+        return;
+    }
+    vector<oaBox> transposed;
+    transposed.reserve(blocks.size());
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        transposed.push_back(transpose(blocks[i]));
+    }
+    buildStrips(transpose(region), transposed);
+    for (size_t i = 0; i < _tiles.size(); ++i) {
+        _tiles[i] = transpose(_tiles[i]);
+    }
+}
+
+// Cut the region into bands at the block edges and take the free x
+// intervals of each band; an interval with the same extent as one of the
+// band below extends that tile instead of starting a new one.
+void
+TilePlane_t::buildStrips(const oaBox &region, const vector<oaBox> &blocks)
+{
+    vector<oaCoord> ys;
+    ys.push_back(region.bottom());
+    ys.push_back(region.top());
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        if (blocks[i].bottom() > region.bottom() && blocks[i].bottom() < region.top()) {
+            ys.push_back(blocks[i].bottom());
+        }
+        if (blocks[i].top() > region.bottom() && blocks[i].top() < region.top()) {
+            ys.push_back(blocks[i].top());
+        }
+    }
+    sort(ys.begin(), ys.end());
+    ys.erase(unique(ys.begin(), ys.end()), ys.end());
+
+    // tiles of the previous band, sorted by left
+    vector<size_t> below;
+    vector<size_t> current;
+    vector<pair<oaCoord, oaCoord> > cuts;
+    for (size_t band = 0; band + 1 < ys.size(); ++band) {
+        oaCoord bottom = ys[band];
+        oaCoord top = ys[band + 1];
+        cuts.clear();
+        for (size_t i = 0; i < blocks.size(); ++i) {
+            const oaBox &block = blocks[i];
+            if (block.bottom() < top && block.top() > bottom && \
+                    block.left() < region.right() && block.right() > region.left()) {
+                cuts.push_back(make_pair(block.left(), block.right()));
+            }
+        }
+        sort(cuts.begin(), cuts.end());
+
+        current.clear();
+        size_t next = 0;
+        oaCoord left = region.left();
+        for (size_t i = 0; i <= cuts.size(); ++i) {
+            oaCoord right = (i < cuts.size()) ? min(cuts[i].first, region.right()) : \
+                            region.right();
+            if (left < right) {
+                while (next < below.size() && _tiles[below[next]].left() < left) {
+                    ++next;
+                }
+                if (next < below.size() && _tiles[below[next]].left() == left && \
+                        _tiles[below[next]].right() == right) {
+                    _tiles[below[next]].top() = top;
+                    current.push_back(below[next]);
+                }
+                else {
+                    current.push_back(_tiles.size());
+                    _tiles.push_back(oaBox(left, bottom, right, top));
+                }
+            }
+            if (i < cuts.size()) {
+                left = max(left, cuts[i].second);
+            }
+        }
+        below.swap(current);
+    }
+}
+
+long
+TilePlane_t::find(const oaPoint &point) const
+{
+    for (size_t i = 0; i < _tiles.size(); ++i) {
+        if (_tiles[i].contains(point)) {
+            return i;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,30 @@
+// The class TilePlane_t covers the free space of a routing layer with
+// maximal strips, the tiles a corner-stitched plane keeps for its space:
+// for a HORIZONTAL plane each tile is as wide as the free space allows
+// and vertically adjacent strips of the same extent are merged, so a
+// horizontal wire is free exactly when it lies within one tile. A
+// VERTICAL plane is the same with x and y exchanged.
+#ifndef TILEPLANE_H_
+#define TILEPLANE_H_
+
+#include <vector>
+#include "Geometry.h"
+#include "RouterType.h"
+
+class TilePlane_t {
+public:
+    TilePlane_t() : _tiles() {}
+    // region: the space to cover, blocks: open boxes taken out of it
+    void build(const oa::oaBox &region, const std::vector<oa::oaBox> &blocks, \
+            Orient_t orient);
+    size_t size() const { return _tiles.size(); }
+    const oa::oaBox &tile(size_t i) const { return _tiles[i]; }
+    // a tile containing point, -1 if the point is blocked
+    long find(const oa::oaPoint &point) const;
+private:
+    void buildStrips(const oa::oaBox &region, const std::vector<oa::oaBox> &blocks);
+
+    std::vector<oa::oaBox> _tiles;
+};
+
+#endif
@@ -0,0 +1,164 @@
+#ifdef ROUTER_TRACE
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <time.h>
+#include <pthread.h>
+#include "Trace.h"
+
+using namespace oa;
+using namespace std;
+
+// records per thread, the oldest are overwritten when a ring is full
+#ifndef TRACE_RING_SIZE
+#define TRACE_RING_SIZE 65536
+#endif
+
+// TraceRing_t: ring of one thread at a time. Only its thread writes it,
+// the rings are read by traceDump() after the routing threads have
+// finished. When its thread exits the ring goes on the free list and the
+// next new thread appends to it, so there are as many rings as threads
+// ever ran at once and thread is a slot rather than one thread.
+typedef struct TraceRing {
+    TraceRecord_t records[TRACE_RING_SIZE];
+    oaUInt8 written;
+    oaUInt4 thread;
+    struct TraceRing *next;
+    struct TraceRing *nextFree;
+} TraceRing_t;
+
+const line_t traceNoLine;
+
+static TraceRing_t *rings = NULL;
+static oaUInt4 threadCount = 0;
+static __thread TraceRing_t *ring = NULL;
+
+static TraceRing_t *freeRings = NULL;
+static pthread_mutex_t freeLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t ringKey;
+static pthread_once_t ringKeyOnce = PTHREAD_ONCE_INIT;
+
+// run at thread exit, hand the ring of the thread to the next one
+static void
+releaseRing(void *exited)
+{
+    TraceRing_t *old = static_cast<TraceRing_t*>(exited);
+    pthread_mutex_lock(&freeLock);
+    old->nextFree = freeRings;
+    freeRings = old;
+    pthread_mutex_unlock(&freeLock);
+}
+
+static void
+createRingKey()
+{
+    pthread_key_create(&ringKey, releaseRing);
+}
+
+// take a ring off the free list, or allocate one and push it on the
+// list of all rings without a lock
+static TraceRing_t *
+newRing()
+{
+    pthread_once(&ringKeyOnce, createRingKey);
+    pthread_mutex_lock(&freeLock);
+    TraceRing_t *fresh = freeRings;
+    if (fresh != NULL) {
+        freeRings = fresh->nextFree;
+    }
+    pthread_mutex_unlock(&freeLock);
+
+    if (fresh == NULL) {
+        fresh = new TraceRing_t;
+        fresh->written = 0;
+        fresh->thread = __sync_fetch_and_add(&threadCount, 1);
+        do {
+            fresh->next = rings;
+        } while (!__sync_bool_compare_and_swap(&rings, fresh->next, fresh));
+    }
+    pthread_setspecific(ringKey, fresh);
+    return fresh;
+}
+
+static void
+copyLine(oaInt4 *to, const line_t &line)
+{
+    to[0] = line.first.x();
+    to[1] = line.first.y();
+    to[2] = line.second.x();
+    to[3] = line.second.y();
+}
+
+void
+traceRecord(TraceEvent_t event, oaInt4 netID, const oaPoint &point, int orient, \
+        int sides, const line_t &low, const line_t &high)
+{
+    if (ring == NULL) {
+        ring = newRing();
+    }
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    TraceRecord_t &record = ring->records[ring->written % TRACE_RING_SIZE];
+    record.time = static_cast<oaUInt8>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+    record.event = event;
+    record.orient = orient;
+    record.sides = sides;
+    record.pad = 0;
+    record.netID = netID;
+    record.x = point.x();
+    record.y = point.y();
+    copyLine(record.low, low);
+    copyLine(record.high, high);
+    ++ring->written;
+}
+
+// write all rings to fileName, or to $ROUTER_TRACE_FILE or router.trace
+// if it is NULL
+bool
+traceDump(const char *fileName)
+{
+    if (fileName == NULL) {
+        fileName = getenv("ROUTER_TRACE_FILE");
+    }
+    if (fileName == NULL) {
+        fileName = "router.trace";
+    }
+    FILE *file = fopen(fileName, "wb");
+    if (file == NULL) {
+        cerr << "Cannot open trace file " << fileName << endl;
+        return false;
+    }
+    TraceFileHeader_t header;
+    memcpy(header.magic, "RTRC", 4);
+    header.version = 1;
+    header.recordSize = sizeof(TraceRecord_t);
+    header.threads = 0;
+    for (TraceRing_t *it = rings; it != NULL; it = it->next) {
+        ++header.threads;
+    }
+    bool good = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    for (TraceRing_t *it = rings; it != NULL && good; it = it->next) {
+        oaUInt8 first = 0;
+        if (it->written > TRACE_RING_SIZE) {
+            first = it->written - TRACE_RING_SIZE;
+        }
+        TraceThreadHeader_t threadHeader;
+        threadHeader.thread = it->thread;
+        threadHeader.records = it->written - first;
+        good = fwrite(&threadHeader, sizeof(threadHeader), 1, file) == 1;
+        for (oaUInt8 i = first; i < it->written && good; ++i) {
+            good = fwrite(&it->records[i % TRACE_RING_SIZE], \
+                    sizeof(TraceRecord_t), 1, file) == 1;
+        }
+    }
+    good = fclose(file) == 0 && good;
+    if (!good) {
+        cerr << "Cannot write trace file " << fileName << endl;
+    }
+    return good;
+}
+
+#endif
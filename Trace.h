@@ -0,0 +1,71 @@
+// Tracepoints on the line-probing hot path. Built with -DROUTER_TRACE,
+// every tracepoint appends a fixed-size record to a ring buffer owned by
+// the calling thread, and ROUTER_TRACE_DUMP writes all rings to a file
+// that tools/tracedecode turns into a timeline. Without ROUTER_TRACE the
+// macros expand to nothing and their arguments are not evaluated.
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include "Geometry.h"
+#include "line.h"
+
+typedef enum {
+    TRACE_ESCAPE,           // escape(): point is the object point
+    TRACE_ESCAPE_LINE,      // getEscapeLine(): low/high are the covers
+    TRACE_ESCAPE_POINT_I,   // getEscapePointI(): point is the object point
+    TRACE_ESCAPE_POINT_II,  // getEscapePointII(): point is the object point
+    TRACE_COVER,            // coversAt(): low/high are the covers
+    TRACE_WIRE              // createWire(): low is the wire
+} TraceEvent_t;
+
+// TraceRecord_t: one record as stored in the ring and in the trace file.
+// sides: which of low (1) and high (2) are set
+typedef struct {
+    oa::oaUInt8 time;
+    unsigned char event;
+    unsigned char orient;
+    unsigned char sides;
+    unsigned char pad;
+    oa::oaInt4 netID;
+    oa::oaInt4 x;
+    oa::oaInt4 y;
+    oa::oaInt4 low[4];
+    oa::oaInt4 high[4];
+} TraceRecord_t;
+
+// trace file: TraceFileHeader_t, then per thread a TraceThreadHeader_t
+// followed by its records, oldest first
+typedef struct {
+    char magic[4];
+    oa::oaUInt4 version;
+    oa::oaUInt4 recordSize;
+    oa::oaUInt4 threads;
+} TraceFileHeader_t;
+
+typedef struct {
+    oa::oaUInt4 thread;
+    oa::oaUInt4 records;
+} TraceThreadHeader_t;
+
+#ifdef ROUTER_TRACE
+
+extern const line_t traceNoLine;
+void traceRecord(TraceEvent_t event, oa::oaInt4 netID, const oa::oaPoint &point, \
+        int orient, int sides, const line_t &low, const line_t &high);
+bool traceDump(const char *fileName);
+
+#define ROUTER_TRACE_POINT(event, netID, point, orient) \
+    traceRecord((event), (netID), (point), (orient), 0, traceNoLine, traceNoLine)
+#define ROUTER_TRACE_LINES(event, netID, point, orient, sides, low, high) \
+    traceRecord((event), (netID), (point), (orient), (sides), (low), (high))
+#define ROUTER_TRACE_DUMP(fileName) traceDump(fileName)
+
+#else
+
+#define ROUTER_TRACE_POINT(event, netID, point, orient) do {} while (0)
+#define ROUTER_TRACE_LINES(event, netID, point, orient, sides, low, high) do {} while (0)
+#define ROUTER_TRACE_DUMP(fileName) do {} while (0)
+
+#endif
+
+#endif
@@ -0,0 +1,261 @@
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#include <algorithm>
+#include "TrackGrid.h"
+
+using namespace oa;
+using namespace std;
+
+// first track at or after value for tracks through origin every pitch
+static oaCoord
+gridCeil(oaCoord value, oaCoord origin, oaCoord pitch)
+{
+    oaCoord offset = (value - origin) % pitch;
+    if (offset < 0) {
+        offset += pitch;
+    }
+    return offset ? value - offset + pitch : value;
+}
+
+TrackGrid_t::TrackGrid_t()
+    : _left(0), _bottom(0), _pitch(1), _columns(0), _rows(0), _stride(2)
+{
+}
+
+void
+TrackGrid_t::reset(const oaBox &region, const oaPoint &origin, oaCoord pitch)
+{
+    _pitch = pitch;
+    _left = gridCeil(region.left(), origin.x(), pitch);
+    _bottom = gridCeil(region.bottom(), origin.y(), pitch);
+    _columns = (region.right() >= _left) ? (region.right() - _left) / pitch + 1 : 0;
+    _rows = (region.top() >= _bottom) ? (region.top() - _bottom) / pitch + 1 : 0;
+    _stride = (_columns + 63) / 64 + 2;
+    for (int layer = 0; layer < 2; ++layer) {
+        _free[layer].assign(_stride * (_rows + 2), 0);
+    }
+}
+
+bool
+TrackGrid_t::column(oaCoord x, size_t &column) const
+{
+    if (x < _left || (x - _left) % _pitch != 0 || \
+            static_cast<size_t>((x - _left) / _pitch) >= _columns) {
+        return false;
+    }
+    column = (x - _left) / _pitch;
+    return true;
+}
+
+bool
+TrackGrid_t::row(oaCoord y, size_t &row) const
+{
+    if (y < _bottom || (y - _bottom) % _pitch != 0 || \
+            static_cast<size_t>((y - _bottom) / _pitch) >= _rows) {
+        return false;
+    }
+    row = (y - _bottom) / _pitch;
+    return true;
+}
+
+bool
+TrackGrid_t::onGrid(const oaPoint &point) const
+{
+    size_t i, j;
+    return column(point.x(), i) && row(point.y(), j);
+}
+
+void
+TrackGrid_t::setRange(Bits_t &bits, size_t row, size_t first, size_t last, bool value)
+{
+    for (size_t i = first; i <= last; ++i) {
+        oaUInt8 bit = 1ull << (i % 64);
+        if ((i % 64) == 0 && i + 63 <= last) {
+            bits[index(row, i)] = value ? ~0ull : 0;
+            i += 63;
+        }
+        else if (value) {
+            bits[index(row, i)] |= bit;
+        }
+        else {
+            bits[index(row, i)] &= ~bit;
+        }
+    }
+}
+
+bool
+TrackGrid_t::setFree(int layer, const oaBox &area, const vector<oaBox> &blocks)
+{
+    Bits_t &bits = _free[layer];
+    bits.assign(bits.size(), 0);
+    if (_columns == 0 || _rows == 0) {
+        return true;
+    }
+    // nodes in [first, last] of a closed or an open interval
+    oaCoord firstX = gridCeil(area.left(), _left, _pitch);
+    oaCoord firstY = gridCeil(area.bottom(), _bottom, _pitch);
+    if (firstX > area.right() || firstY > area.top()) {
+        return true;
+    }
+    long i0 = (firstX - _left) / _pitch;
+    long i1 = min<long>(_columns - 1, (area.right() - _left) / _pitch);
+    long j0 = (firstY - _bottom) / _pitch;
+    long j1 = min<long>(_rows - 1, (area.top() - _bottom) / _pitch);
+    i0 = max<long>(i0, 0);
+    j0 = max<long>(j0, 0);
+    for (long j = j0; j <= j1; ++j) {
+        if (i0 <= i1) {
+            setRange(bits, j, i0, i1, true);
+        }
+    }
+
+    for (size_t b = 0; b < blocks.size(); ++b) {
+        const oaBox &block = blocks[b];
+        oaCoord along = (layer == 0) ? block.getHeight() : block.getWidth();
+        if (along <= _pitch) {
+            return false;
+        }
+        // open box: nodes strictly inside
+        long left = gridCeil(block.left() + 1, _left, _pitch);
+        long bottom = gridCeil(block.bottom() + 1, _bottom, _pitch);
+        if (left >= block.right() || bottom >= block.top() || \
+                block.right() - 1 < _left || block.top() - 1 < _bottom) {
+            continue;
+        }
+        long first = max<long>(0, (left - _left) / _pitch);
+        long last = min<long>(static_cast<long>(_columns) - 1, \
+                (block.right() - 1 - _left) / _pitch);
+        long low = max<long>(0, (bottom - _bottom) / _pitch);
+        long high = min<long>(static_cast<long>(_rows) - 1, \
+                (block.top() - 1 - _bottom) / _pitch);
+        for (long j = low; j <= high; ++j) {
+            if (first <= last) {
+                setRange(bits, j, first, last, false);
+            }
+        }
+    }
+    return true;
+}
+
+// One wavefront step: a reached node reaches its neighbours along the
+// tracks of its layer and the node above or below it on the other layer.
+// Returns whether anything new was reached.
+bool
+TrackGrid_t::expand(const Bits_t &reached1, const Bits_t &reached2, Bits_t &next1, \
+        Bits_t &next2) const
+{
+    const oaUInt8 *r1 = &reached1[0];
+    const oaUInt8 *r2 = &reached2[0];
+    const oaUInt8 *f1 = &_free[0][0];
+    const oaUInt8 *f2 = &_free[1][0];
+    oaUInt8 *n1 = &next1[0];
+    oaUInt8 *n2 = &next2[0];
+    size_t words = _stride - 2;
+    oaUInt8 changed = 0;
+    for (size_t j = 0; j < _rows; ++j) {
+        size_t k = index(j, 0);
+        size_t end = k + words;
+#ifdef __AVX2__
+        __m256i grown = _mm256_setzero_si256();
+        for (; k + 4 <= end; k += 4) {
+            __m256i a = _mm256_loadu_si256((const __m256i *)(r1 + k));
+            __m256i b = _mm256_loadu_si256((const __m256i *)(r2 + k));
+            __m256i up = _mm256_loadu_si256((const __m256i *)(r1 + k + _stride));
+            __m256i down = _mm256_loadu_si256((const __m256i *)(r1 + k - _stride));
+            __m256i before = _mm256_loadu_si256((const __m256i *)(r2 + k - 1));
+            __m256i after = _mm256_loadu_si256((const __m256i *)(r2 + k + 1));
+            __m256i m1 = _mm256_or_si256(_mm256_or_si256(a, b), _mm256_or_si256(up, down));
+            __m256i m2 = _mm256_or_si256(_mm256_or_si256(a, b), \
+                    _mm256_or_si256(_mm256_slli_epi64(b, 1), _mm256_srli_epi64(b, 1)));
+            m2 = _mm256_or_si256(m2, _mm256_or_si256(_mm256_srli_epi64(before, 63), \
+                        _mm256_slli_epi64(after, 63)));
+            m1 = _mm256_and_si256(m1, _mm256_loadu_si256((const __m256i *)(f1 + k)));
+            m2 = _mm256_and_si256(m2, _mm256_loadu_si256((const __m256i *)(f2 + k)));
+            _mm256_storeu_si256((__m256i *)(n1 + k), m1);
+            _mm256_storeu_si256((__m256i *)(n2 + k), m2);
+            grown = _mm256_or_si256(grown, _mm256_or_si256(_mm256_xor_si256(m1, a), \
+                        _mm256_xor_si256(m2, b)));
+        }
+        changed |= !_mm256_testz_si256(grown, grown);
+#endif
+        for (; k < end; ++k) {
+            oaUInt8 m1 = (r1[k] | r2[k] | r1[k + _stride] | r1[k - _stride]) & f1[k];
+            oaUInt8 m2 = (r2[k] | r1[k] | (r2[k] << 1) | (r2[k] >> 1) | \
+                    (r2[k - 1] >> 63) | (r2[k + 1] << 63)) & f2[k];
+            changed |= (m1 ^ r1[k]) | (m2 ^ r2[k]);
+            n1[k] = m1;
+            n2[k] = m2;
+        }
+    }
+    return changed != 0;
+}
+
+// Lee wavefront over both layers; waves[s] holds the nodes reached in s
+// steps, the path is traced back through them.
+bool
+TrackGrid_t::search(const oaPoint &from, const oaPoint &to, vector<oaPoint> &path, \
+        const CancelToken_t *cancel)
+{
+    size_t fromColumn, fromRow, toColumn, toRow;
+    if (!column(from.x(), fromColumn) || !row(from.y(), fromRow) || \
+            !column(to.x(), toColumn) || !row(to.y(), toRow)) {
+        return false;
+    }
+    vector<Bits_t> waves[2];
+    for (int layer = 0; layer < 2; ++layer) {
+        waves[layer].push_back(Bits_t(_free[layer].size(), 0));
+        if (test(_free[layer], fromRow, fromColumn)) {
+            waves[layer][0][index(fromRow, fromColumn)] |= 1ull << (fromColumn % 64);
+        }
+    }
+    int layer = -1;
+    while (layer < 0) {
+        size_t step = waves[0].size() - 1;
+        for (int l = 0; l < 2 && layer < 0; ++l) {
+            if (test(waves[l][step], toRow, toColumn)) {
+                layer = l;
+            }
+        }
+        if (layer >= 0) {
+            break;
+        }
+        if (cancel != NULL && cancel->cancelled()) {
+            return false;
+        }
+        waves[0].push_back(Bits_t(_free[0].size(), 0));
+        waves[1].push_back(Bits_t(_free[1].size(), 0));
+        if (!expand(waves[0][step], waves[1][step], waves[0][step + 1], waves[1][step + 1])) {
+            return false;
+        }
+    }
+
+    // each node first reached at step s has a neighbour reached at s - 1,
+    // prefer staying on the layer
+    path.clear();
+    size_t i = toColumn;
+    size_t j = toRow;
+    path.push_back(to);
+    for (size_t step = waves[0].size() - 1; step > 0; --step) {
+        const Bits_t &same = waves[layer][step - 1];
+        const Bits_t &other = waves[1 - layer][step - 1];
+        if (layer == 0 && j > 0 && test(same, j - 1, i)) {
+            --j;
+        }
+        else if (layer == 0 && j + 1 < _rows && test(same, j + 1, i)) {
+            ++j;
+        }
+        else if (layer == 1 && i > 0 && test(same, j, i - 1)) {
+            --i;
+        }
+        else if (layer == 1 && i + 1 < _columns && test(same, j, i + 1)) {
+            ++i;
+        }
+        else if (test(other, j, i)) {
+            layer = 1 - layer;
+        }
+        path.push_back(oaPoint(_left + i * _pitch, _bottom + j * _pitch));
+    }
+    reverse(path.begin(), path.end());
+    return true;
+}
@@ -0,0 +1,55 @@
+// The class TrackGrid_t is the routing grid of the gridded mode: metal1
+// tracks run vertically and metal2 tracks horizontally, one every pitch
+// through a common origin. Free nodes are kept as bitsets, one row of
+// 64-bit words per metal2 track for either layer, so a Lee wavefront
+// step expands a whole word of nodes with a few shifts and masks (four
+// words at a time when built with AVX2).
+#ifndef TRACKGRID_H_
+#define TRACKGRID_H_
+
+#include <vector>
+#include "Geometry.h"
+#include "CancelToken.h"
+
+class TrackGrid_t {
+public:
+    TrackGrid_t();
+    // tracks through origin every pitch covering region, all nodes blocked
+    void reset(const oa::oaBox &region, const oa::oaPoint &origin, oa::oaCoord pitch);
+    bool onGrid(const oa::oaPoint &point) const;
+    // layer 0: metal1, wires move along y, layer 1: metal2, along x.
+    // Free the nodes inside area and outside every open block. Returns
+    // false if a block is not longer than a pitch along the wires, as a
+    // block between two nodes would then cut a wire unseen.
+    bool setFree(int layer, const oa::oaBox &area, const std::vector<oa::oaBox> &blocks);
+    // shortest path in steps, a via counts as one; path gets every node
+    // of it, from first. cancel is polled once per wavefront step.
+    bool search(const oa::oaPoint &from, const oa::oaPoint &to, \
+            std::vector<oa::oaPoint> &path, const CancelToken_t *cancel=NULL);
+private:
+    typedef std::vector<oa::oaUInt8> Bits_t;
+
+    // word of column column in row row, rows and words are padded by one
+    // zero word on each side
+    size_t index(size_t row, size_t column) const {
+        return (row + 1) * _stride + column / 64 + 1;
+    }
+    bool test(const Bits_t &bits, size_t row, size_t column) const {
+        return (bits[index(row, column)] >> (column % 64)) & 1;
+    }
+    void setRange(Bits_t &bits, size_t row, size_t first, size_t last, bool value);
+    bool column(oa::oaCoord x, size_t &column) const;
+    bool row(oa::oaCoord y, size_t &row) const;
+    bool expand(const Bits_t &reached1, const Bits_t &reached2, Bits_t &next1, \
+            Bits_t &next2) const;
+
+    oa::oaCoord _left;
+    oa::oaCoord _bottom;
+    oa::oaCoord _pitch;
+    size_t _columns;
+    size_t _rows;
+    size_t _stride;
+    Bits_t _free[2];
+};
+
+#endif
@@ -0,0 +1,190 @@
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include "CellGen.h"
+
+using namespace oa;
+using namespace std;
+
+// design rules in file units, DRC_t scales them by 10 (areas by 100)
+static const oaInt4 METAL_WIDTH = 6;
+static const oaInt4 METAL_SPACING = 6;
+static const oaInt4 VIA_EXTENSION = 2;
+static const oaInt4 METAL_AREA = 60;
+static const oaInt4 VIA_WIDTH = 6;
+static const oaInt4 VIA_HEIGHT = 6;
+
+// site grid in coordinate units: room for a contact and a wire on each
+// side between two sites
+static const oaCoord PITCH_X = 2 * 10 * (VIA_WIDTH + METAL_SPACING + METAL_WIDTH);
+static const oaCoord PITCH_Y = 2 * 10 * (VIA_HEIGHT + METAL_SPACING + METAL_WIDTH);
+static const unsigned ROWS = 5;
+static const oaCoord RAIL_HALF_HEIGHT = 90;
+static const oaCoord MARGIN = PITCH_X / 2;
+
+static bool
+columnLess(const oaPoint &lhs, const oaPoint &rhs)
+{
+    if (lhs.x() != rhs.x()) {
+        return lhs.x() < rhs.x();
+    }
+    return lhs.y() < rhs.y();
+}
+
+// Contacts of VDD and VSS sit in the rows next to their rails. Signal
+// nets take runs of neighbouring occupied sites in column order, so that
+// their contacts are local like in a real cell.
+CellGen_t::CellGen_t(const CellSpec_t &spec)
+    : _state(spec.seed * 2654435761u + 1), _VDDBox(), _VSSBox(), _nets()
+{
+    // scaled pitches stay on a multiple of 20 so that sites stay on grid
+    oaCoord pitchX = static_cast<oaCoord>(PITCH_X * spec.pitch) / 20 * 20;
+    oaCoord pitchY = static_cast<oaCoord>(PITCH_Y * spec.pitch) / 20 * 20;
+    oaCoord width = 2 * MARGIN + spec.columns * pitchX;
+    oaCoord height = (ROWS + 1) * pitchY;
+    _VSSBox = oaBox(0, -RAIL_HALF_HEIGHT, width, RAIL_HALF_HEIGHT);
+    _VDDBox = oaBox(0, height - RAIL_HALF_HEIGHT, width, height + RAIL_HALF_HEIGHT);
+
+    vector<oaPoint> sites;
+    GenNet_t vdd, vss;
+    vdd.type = VDD;
+    vss.type = VSS;
+    for (unsigned col = 0; col < spec.columns; ++col) {
+        oaCoord x = MARGIN + col * pitchX;
+        for (unsigned row = 0; row < ROWS; ++row) {
+            oaPoint site(x, (row + 1) * pitchY - 10 * VIA_HEIGHT / 2);
+            if (row == 0 && uniform() < 0.25) {
+                vss.contacts.push_back(site);
+            }
+            else if (row == ROWS - 1 && uniform() < 0.25) {
+                vdd.contacts.push_back(site);
+            }
+            else if (uniform() < spec.density) {
+                sites.push_back(site);
+            }
+        }
+    }
+    if (!vss.contacts.empty()) {
+        _nets.push_back(vss);
+    }
+    if (!vdd.contacts.empty()) {
+        _nets.push_back(vdd);
+    }
+
+    sort(sites.begin(), sites.end(), columnLess);
+    unsigned maxPins = max(spec.maxPins, 2u);
+    unsigned ports = 0;
+    size_t next = 0;
+    while (next < sites.size()) {
+        GenNet_t net;
+        unsigned pins;
+        if (uniform() < spec.ioFraction) {
+            net.type = IO;
+            ostringstream name;
+            name << "P" << ports++;
+            net.portName = name.str();
+            pins = 1 + random() % min(maxPins, 3u);
+        }
+        else {
+            net.type = S;
+            pins = 2 + random() % (maxPins - 1);
+        }
+        // leave some sites of a run to later nets so that nets interleave
+        for (size_t i = next; i < sites.size() && net.contacts.size() < pins; ++i) {
+            if (i == next || uniform() < 0.7) {
+                net.contacts.push_back(sites[i]);
+                sites.erase(sites.begin() + i);
+                --i;
+            }
+        }
+        if (net.type == S && net.contacts.size() < 2) {
+            break;
+        }
+        _nets.push_back(net);
+    }
+}
+
+unsigned
+CellGen_t::random()
+{
+    // xorshift32, the same sequence on every platform
+    _state ^= _state << 13;
+    _state ^= _state >> 17;
+    _state ^= _state << 5;
+    return _state;
+}
+
+size_t
+CellGen_t::contactCount() const
+{
+    size_t count = 0;
+    vector<GenNet_t>::const_iterator netIter;
+    for (netIter = _nets.begin(); netIter != _nets.end(); ++netIter) {
+        count += netIter->contacts.size();
+    }
+    return count;
+}
+
+bool
+CellGen_t::write(const string &prefix) const
+{
+    ofstream conn((prefix + ".txt").c_str());
+    ofstream rule((prefix + ".rule").c_str());
+    ofstream rails((prefix + ".rails").c_str());
+    if (!conn.good() || !rule.good() || !rails.good()) {
+        return false;
+    }
+
+    vector<GenNet_t>::const_iterator netIter;
+    for (netIter = _nets.begin(); netIter != _nets.end(); ++netIter) {
+        vector<oaPoint>::const_iterator it;
+        for (it = netIter->contacts.begin(); it != netIter->contacts.end(); ++it) {
+            conn << it->x() << " " << it->y() << " ";
+        }
+        switch (netIter->type) {
+        case VDD:
+            conn << "VDD";
+            break;
+        case VSS:
+            conn << "VSS";
+            break;
+        case S:
+            conn << "S";
+            break;
+        case IO:
+            conn << "IO/" << netIter->portName;
+            break;
+        }
+        conn << endl;
+    }
+
+    rule << METAL_WIDTH << " " << METAL_SPACING << " " << VIA_EXTENSION << " ";
+    rule << METAL_AREA << " " << VIA_WIDTH << " " << VIA_HEIGHT << endl;
+
+    rails << "VDD " << _VDDBox.left() << " " << _VDDBox.bottom() << " ";
+    rails << _VDDBox.right() << " " << _VDDBox.top() << endl;
+    rails << "VSS " << _VSSBox.left() << " " << _VSSBox.bottom() << " ";
+    rails << _VSSBox.right() << " " << _VSSBox.top() << endl;
+    return conn.good() && rule.good() && rails.good();
+}
+
+bool
+CellGen_t::readRails(const string &prefix, oaBox &VDDBox, oaBox &VSSBox)
+{
+    ifstream rails((prefix + ".rails").c_str());
+    string name;
+    oaCoord left, bottom, right, top;
+    bool VDDFound = false;
+    bool VSSFound = false;
+    while (rails >> name >> left >> bottom >> right >> top) {
+        if (name == "VDD") {
+            VDDBox = oaBox(left, bottom, right, top);
+            VDDFound = true;
+        }
+        else if (name == "VSS") {
+            VSSBox = oaBox(left, bottom, right, top);
+            VSSFound = true;
+        }
+    }
+    return VDDFound && VSSFound;
+}
@@ -0,0 +1,59 @@
+// The class CellGen_t generates a random standard cell for benchmarking:
+// a VDD and a VSS rail, contacts on a site grid between them, and the
+// nets connecting them, written in the formats the router reads.
+#ifndef CELLGEN_H_
+#define CELLGEN_H_
+
+#include <string>
+#include <vector>
+#include "Geometry.h"
+#include "RouterType.h"
+
+// CellSpec_t: knobs of a generated cell
+// columns: number of contact columns, sets the cell width
+// density: fraction of free contact sites that carry a contact
+// ioFraction: fraction of the signal nets that are IO nets
+// maxPins: largest number of contacts of a signal net
+// pitch: site pitch as a fraction of the default one, below 1 there is
+// not always room for a wire beside a contact and L/Z routes get blocked
+typedef struct {
+    unsigned seed;
+    unsigned columns;
+    double density;
+    double ioFraction;
+    unsigned maxPins;
+    double pitch;
+} CellSpec_t;
+
+class CellGen_t {
+public:
+    CellGen_t(const CellSpec_t &spec);
+
+    // write prefix.txt (connections), prefix.rule (design rules) and
+    // prefix.rails (rail boxes), returns false if a file cannot be written
+    bool write(const std::string &prefix) const;
+    // read the rail boxes written by write()
+    static bool readRails(const std::string &prefix, oa::oaBox &VDDBox, \
+            oa::oaBox &VSSBox);
+
+    const oa::oaBox &VDDBox() const { return _VDDBox; }
+    const oa::oaBox &VSSBox() const { return _VSSBox; }
+    size_t contactCount() const;
+private:
+    // GenNet_t: a generated net, portName is used by IO nets only
+    typedef struct {
+        std::vector<oa::oaPoint> contacts;
+        NetType_t type;
+        std::string portName;
+    } GenNet_t;
+
+    unsigned random();
+    double uniform() { return random() / 4294967296.0; }
+
+    unsigned _state;
+    oa::oaBox _VDDBox;
+    oa::oaBox _VSSBox;
+    std::vector<GenNet_t> _nets;
+};
+
+#endif
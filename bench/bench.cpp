@@ -0,0 +1,227 @@
+// bench: route a fixed, seeded corpus of generated cells with the
+// in-memory backend and report time, probes and success per cell
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <cerrno>
+#include "CellGen.h"
+#include "MemoryBackend.h"
+#include "Router.h"
+#include "Trace.h"
+
+using namespace oa;
+using namespace std;
+
+// BenchResult_t: outcome of routing one cell
+typedef struct {
+    string name;
+    size_t contacts;
+    double seconds;
+    oaUInt8 probes;
+    oaUInt8 connections;
+    oaUInt8 patternRoutes;
+    size_t failures;
+    // failed connections by FailReason_t
+    size_t reasons[NO_PATH + 1];
+    bool routed;
+} BenchResult_t;
+
+static double
+wallTime()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+// value at fraction q of sorted
+static double
+percentile(const vector<double> &sorted, double q)
+{
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t index = static_cast<size_t>(q * (sorted.size() - 1) + 0.5);
+    return sorted[index];
+}
+
+// The corpus: every (columns, density, pitch) triple with a few seeds
+// each, so the same cells are routed on every run. The tight pitch
+// blocks some L/Z routes and leaves them to the engine.
+static void
+corpus(unsigned cells, unsigned seed, vector<CellSpec_t> &specs)
+{
+    static const unsigned columns[] = {4, 8, 12, 16, 24, 32};
+    static const double densities[] = {0.4, 0.6, 0.85};
+    static const double pitches[] = {1.0, 0.8};
+    for (unsigned i = 0; i < cells; ++i) {
+        CellSpec_t spec;
+        spec.seed = seed + i;
+        spec.columns = columns[i % 6];
+        spec.density = densities[(i / 6) % 3];
+        spec.ioFraction = 0.3;
+        spec.maxPins = 4;
+        spec.pitch = pitches[(i / 18) % 2];
+        specs.push_back(spec);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    // -engine probe|tile|fallback|grid|race: see Router_t::Engine_t
+    // -cache dir: see RouteCache_t
+    // -portfolio workers: see Router_t::setPortfolio
+    // -nopattern: see Router_t::setPatternRouting
+    Router_t::Engine_t engine = Router_t::PROBE_ENGINE;
+    const char *cacheDir = NULL;
+    unsigned portfolio = 0;
+    bool patternRouting = true;
+    while ((argc > 1 && strcmp(argv[1], "-nopattern") == 0) || \
+            (argc > 2 && (strcmp(argv[1], "-engine") == 0 || strcmp(argv[1], "-cache") == 0 || \
+                strcmp(argv[1], "-portfolio") == 0))) {
+        if (strcmp(argv[1], "-nopattern") == 0) {
+            patternRouting = false;
+            argv[1] = argv[0];
+            --argc;
+            ++argv;
+            continue;
+        }
+        if (strcmp(argv[1], "-cache") == 0) {
+            cacheDir = argv[2];
+        }
+        else if (strcmp(argv[1], "-portfolio") == 0) {
+            portfolio = atoi(argv[2]);
+        }
+        else if (!Router_t::parseEngine(argv[2], engine)) {
+            cerr << "Unknown engine: " << argv[2] << endl;
+            return 1;
+        }
+        argv[2] = argv[0];
+        argc -= 2;
+        argv += 2;
+    }
+    if (argc > 6) {
+        cerr << "Usage: ./bench [-engine name] [-cache dir] [-portfolio workers] [-nopattern]";
+        cerr << " [cells [seed [dir [max_probes [max_seconds]]]]]." << endl;
+        return 1;
+    }
+    if (cacheDir != NULL && mkdir(cacheDir, 0777) != 0 && errno != EEXIST) {
+        cerr << "Cannot create directory: " << cacheDir << endl;
+        return 1;
+    }
+    RouteCache_t cache(cacheDir != NULL ? cacheDir : "");
+    unsigned cells = (argc > 1) ? atoi(argv[1]) : 72;
+    unsigned seed = (argc > 2) ? atoi(argv[2]) : 1;
+    string dir = (argc > 3) ? argv[3] : "bench/corpus";
+    oaUInt4 maxProbes = (argc > 4) ? atoi(argv[4]) : Router_t::DEFAULT_MAX_PROBES;
+    double maxSeconds = (argc > 5) ? atof(argv[5]) : Router_t::DEFAULT_MAX_SECONDS;
+
+    vector<CellSpec_t> specs;
+    corpus(cells, seed, specs);
+
+    // the router prints its progress on cout, keep it out of the report
+    ofstream devNull("/dev/null");
+    streambuf *report = cout.rdbuf();
+
+    vector<BenchResult_t> results;
+    // seconds of every connection left to the engines, over all cells
+    vector<double> latencies;
+    vector<CellSpec_t>::const_iterator specIter;
+    for (specIter = specs.begin(); specIter != specs.end(); ++specIter) {
+        ostringstream name;
+        name << dir << "/cell" << specIter->seed;
+        CellGen_t cell(*specIter);
+        if (!cell.write(name.str())) {
+            cerr << "Cannot write cell: " << name.str() << endl;
+            return 1;
+        }
+
+        MemoryBackend_t backend(cell.VDDBox(), cell.VSSBox());
+
+        cout.rdbuf(devNull.rdbuf());
+        double start = wallTime();
+        Router_t router(backend, (name.str() + ".txt").c_str(), (name.str() + ".rule").c_str());
+        router.setProbeBudget(maxProbes, maxSeconds);
+        router.setEngine(engine);
+        router.setCache(cacheDir != NULL ? &cache : NULL);
+        router.setPortfolio(portfolio);
+        router.setPatternRouting(patternRouting);
+        bool routed = router.route() || router.rerouteFailedNets();
+        router.commit();
+        double seconds = wallTime() - start;
+        cout.rdbuf(report);
+
+        BenchResult_t result;
+        result.name = name.str();
+        result.contacts = cell.contactCount();
+        result.seconds = seconds;
+        result.probes = router.totalProbes();
+        result.connections = router.connections();
+        result.patternRoutes = router.patternRoutes();
+        result.failures = router.failures().size();
+        fill(result.reasons, result.reasons + NO_PATH + 1, 0);
+        vector<ConnectionFailure_t>::const_iterator failIter;
+        for (failIter = router.failures().begin(); failIter != router.failures().end(); \
+                ++failIter) {
+            ++result.reasons[failIter->reason];
+        }
+        result.routed = routed;
+        results.push_back(result);
+        const vector<double> &cellLatencies = router.stats().latencies();
+        latencies.insert(latencies.end(), cellLatencies.begin(), cellLatencies.end());
+    }
+
+    cout << "cell contacts ms probes failures result" << endl;
+    vector<double> times;
+    unsigned passed = 0;
+    oaUInt8 probes = 0;
+    oaUInt8 connections = 0;
+    oaUInt8 patternRoutes = 0;
+    size_t reasons[NO_PATH + 1] = {0};
+    vector<BenchResult_t>::const_iterator resultIter;
+    for (resultIter = results.begin(); resultIter != results.end(); ++resultIter) {
+        cout << resultIter->name << " " << resultIter->contacts << " ";
+        cout << resultIter->seconds * 1e3 << " " << resultIter->probes << " ";
+        cout << resultIter->failures << " " << (resultIter->routed ? "PASS" : "FAIL") << endl;
+        times.push_back(resultIter->seconds * 1e3);
+        passed += resultIter->routed ? 1 : 0;
+        probes += resultIter->probes;
+        connections += resultIter->connections;
+        patternRoutes += resultIter->patternRoutes;
+        for (int reason = NO_ESCAPE; reason <= NO_PATH; ++reason) {
+            reasons[reason] += resultIter->reasons[reason];
+        }
+    }
+    sort(times.begin(), times.end());
+    double total = 0;
+    for (size_t i = 0; i < times.size(); ++i) {
+        total += times[i];
+    }
+    cout << "cells: " << results.size() << " routed: " << passed;
+    cout << " success: " << (results.empty() ? 0 : 100.0 * passed / results.size()) << "%" << endl;
+    cout << "total ms: " << total << " p50 ms: " << percentile(times, 0.5);
+    cout << " p99 ms: " << percentile(times, 0.99) << " probes: " << probes << endl;
+    cout << "connections: " << connections << " pattern routed: ";
+    cout << (connections ? 100.0 * patternRoutes / connections : 0) << "%" << endl;
+    cout << "failed connections:";
+    for (int reason = NO_ESCAPE; reason <= NO_PATH; ++reason) {
+        cout << " " << Router_t::failReasonName(static_cast<FailReason_t>(reason));
+        cout << ": " << reasons[reason];
+    }
+    cout << endl;
+    sort(latencies.begin(), latencies.end());
+    cout << "engine connections: " << latencies.size() << " p50 us: ";
+    cout << percentile(latencies, 0.5) * 1e6 << " p90 us: " << percentile(latencies, 0.9) * 1e6;
+    cout << " p99 us: " << percentile(latencies, 0.99) * 1e6 << endl;
+    if (cacheDir != NULL) {
+        cout << "cache hits: " << cache.hits() << " misses: " << cache.misses() << endl;
+    }
+    ROUTER_TRACE_DUMP(NULL);
+    return 0;
+}
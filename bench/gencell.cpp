@@ -0,0 +1,30 @@
+// gencell: write one random cell for the router
+#include <iostream>
+#include <cstdlib>
+#include "CellGen.h"
+
+using namespace std;
+
+int main(int argc, char *argv[])
+{
+    if (argc < 5 || argc > 8) {
+        cerr << "Usage: ./gencell prefix seed columns density";
+        cerr << " [io_fraction [max_pins [pitch]]]." << endl;
+        return 1;
+    }
+    CellSpec_t spec;
+    spec.seed = atoi(argv[2]);
+    spec.columns = atoi(argv[3]);
+    spec.density = atof(argv[4]);
+    spec.ioFraction = (argc > 5) ? atof(argv[5]) : 0.3;
+    spec.maxPins = (argc > 6) ? atoi(argv[6]) : 4;
+    spec.pitch = (argc > 7) ? atof(argv[7]) : 1.0;
+
+    CellGen_t cell(spec);
+    if (!cell.write(argv[1])) {
+        cerr << "Cannot write cell: " << argv[1] << endl;
+        return 1;
+    }
+    cout << argv[1] << ": " << cell.contactCount() << " contacts" << endl;
+    return 0;
+}
@@ -0,0 +1,192 @@
+// indexbench: build the four barrier sets of a router from random boxes
+// and time cover queries, with the containers of the original router
+// (std::multimap walked edge by edge) against BarrierIndex_t and
+// FlatMultimap_t. Each side runs in its own process, so the peak RSS
+// delta is its own.
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <map>
+#include <cstdlib>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "BarrierIndex.h"
+#include "FlatMap.h"
+
+using namespace oa;
+using namespace std;
+
+typedef multimap<oaCoord, pair<oaInt4, line_t> > OldSet_t;
+typedef FlatMultimap_t<oaCoord, pair<oaInt4, line_t> > NewSet_t;
+
+// Box_t: an M1 or M2 obstacle, its edges go into all four sets
+typedef struct {
+    oaCoord left, bottom, right, top;
+    oaInt4 netID;
+} Box_t;
+
+// clearance the spans are widened by, as metalSpacing + metalWidth / 2
+static const oaInt4 MARGIN = 600;
+static const int NETS = 30;
+static const int QUERIES = 200000;
+// sink for results, so the compiler keeps the queries
+static volatile long sink;
+
+static double
+wallTime()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+// peak resident set of this process in KB
+static long
+peakRss()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+// the walk of the original Router_t::getCover for LEFT
+static bool
+oldLeftCover(const OldSet_t &barriers, oaCoord x, oaCoord y, oaInt4 netID, line_t &cover)
+{
+    OldSet_t::const_iterator it = barriers.lower_bound(x);
+    while (it != barriers.begin()) {
+        --it;
+        if (it->second.first == netID) {
+            continue;
+        }
+        const line_t &seg = it->second.second;
+        if (seg.first.y() - MARGIN < y && y < seg.second.y() + MARGIN) {
+            cover = seg;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void
+report(const char *name, size_t boxes, double build, long rss, double query)
+{
+    cout << setw(10) << left << name << right << setw(8) << boxes;
+    cout << fixed << setprecision(2) << setw(12) << build * 1e3;
+    cout << setw(12) << rss / 1024.0 << setprecision(0) << setw(12) << query * 1e9 << endl;
+}
+
+static void
+runOld(const vector<Box_t> &boxes, oaCoord width)
+{
+    long base = peakRss();
+    double start = wallTime();
+    OldSet_t m1Barriers, m2Barriers, m1Vlines, m2Hlines;
+    for (size_t i = 0; i < boxes.size(); ++i) {
+        const Box_t &box = boxes[i];
+        line_t edge(oaPoint(box.left, box.bottom), oaPoint(box.left, box.top));
+        pair<oaInt4, line_t> value(box.netID, edge);
+        m1Barriers.insert(make_pair(box.bottom, value));
+        m1Barriers.insert(make_pair(box.top, value));
+        m2Barriers.insert(make_pair(box.left, value));
+        m2Barriers.insert(make_pair(box.right, value));
+        m1Vlines.insert(make_pair(box.left, value));
+        m1Vlines.insert(make_pair(box.right, value));
+        m2Hlines.insert(make_pair(box.bottom, value));
+        m2Hlines.insert(make_pair(box.top, value));
+    }
+    double built = wallTime();
+    for (int k = 0; k < QUERIES; ++k) {
+        line_t cover;
+        sink += oldLeftCover(m2Barriers, rand() % width, rand() % 20000, rand() % NETS, \
+                cover);
+    }
+    double query = (wallTime() - built) / QUERIES;
+    report("multimap", boxes.size(), built - start, peakRss() - base, query);
+}
+
+static void
+runNew(const vector<Box_t> &boxes, oaCoord width)
+{
+    long base = peakRss();
+    double start = wallTime();
+    BarrierIndex_t m1Barriers, m2Barriers;
+    NewSet_t m1Vlines, m2Hlines;
+    m1Barriers.setMargin(MARGIN);
+    m2Barriers.setMargin(MARGIN);
+    // as Router_t::initObstacles
+    m1Barriers.beginBulk();
+    m2Barriers.beginBulk();
+    for (size_t i = 0; i < boxes.size(); ++i) {
+        const Box_t &box = boxes[i];
+        line_t edge(oaPoint(box.left, box.bottom), oaPoint(box.left, box.top));
+        pair<oaInt4, line_t> value(box.netID, edge);
+        m1Barriers.insert(box.bottom, box.left, box.right, box.netID, edge);
+        m1Barriers.insert(box.top, box.left, box.right, box.netID, edge);
+        m2Barriers.insert(box.left, box.bottom, box.top, box.netID, edge);
+        m2Barriers.insert(box.right, box.bottom, box.top, box.netID, edge);
+        m1Vlines.insert(make_pair(box.left, value));
+        m1Vlines.insert(make_pair(box.right, value));
+        m2Hlines.insert(make_pair(box.bottom, value));
+        m2Hlines.insert(make_pair(box.top, value));
+    }
+    m1Barriers.endBulk();
+    m2Barriers.endBulk();
+    m1Vlines.begin();
+    m2Hlines.begin();
+    double built = wallTime();
+    for (int k = 0; k < QUERIES; ++k) {
+        line_t cover;
+        sink += m2Barriers.findBefore(rand() % width, rand() % 20000, rand() % NETS, cover);
+    }
+    double query = (wallTime() - built) / QUERIES;
+    report("index", boxes.size(), built - start, peakRss() - base, query);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 2) {
+        cerr << "Usage: ./indexbench [span]." << endl;
+        return 1;
+    }
+    // height range of the boxes, the taller they are the more stabbing
+    // tree nodes each barrier is listed in
+    int span = (argc > 1) ? atoi(argv[1]) : 3000;
+    static const size_t sizes[] = {1000, 10000, 100000};
+
+    cout << setw(10) << left << "sets" << right << setw(8) << "boxes";
+    cout << setw(12) << "build ms" << setw(12) << "rss MB" << setw(12) << "query ns" << endl;
+    cout.flush();
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        // the cell widens with the box count, the density stays the same
+        oaCoord width = sizes[s] * 40;
+        srand(7);
+        vector<Box_t> boxes(sizes[s]);
+        for (size_t i = 0; i < boxes.size(); ++i) {
+            boxes[i].left = rand() % width;
+            boxes[i].right = boxes[i].left + 650;
+            boxes[i].bottom = rand() % 20000;
+            boxes[i].top = boxes[i].bottom + 650 + rand() % (span + 1);
+            boxes[i].netID = rand() % NETS;
+        }
+        for (int side = 0; side < 2; ++side) {
+            pid_t pid = fork();
+            if (pid == 0) {
+                srand(11);
+                if (side == 0) {
+                    runOld(boxes, width);
+                }
+                else {
+                    runNew(boxes, width);
+                }
+                cout.flush();
+                _exit(0);
+            }
+            int status;
+            waitpid(pid, &status, 0);
+        }
+    }
+    return 0;
+}
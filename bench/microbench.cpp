@@ -0,0 +1,502 @@
+// microbench: time the line-probing primitives on obstacle sets recorded
+// from routing generated cells, in ns, heap allocations and cache misses
+// per operation
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <new>
+#include <cstdlib>
+#include <cstring>
+#include <time.h>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+#include "CellGen.h"
+#include "MemoryBackend.h"
+#include "Router.h"
+#include "EndPoint.h"
+
+using namespace oa;
+using namespace std;
+
+// every heap allocation of the process goes through here
+static unsigned long allocations = 0;
+
+#if __cplusplus >= 201103L
+#define NEW_THROW
+#define DELETE_THROW noexcept
+#else
+#define NEW_THROW throw(std::bad_alloc)
+#define DELETE_THROW throw()
+#endif
+// inlined, the hooks read to gcc as malloc() and free() paired with
+// new and delete (-Wmismatched-new-delete), keep them calls
+#ifdef __GNUC__
+#define HOOK_CALL __attribute__((noinline))
+#else
+#define HOOK_CALL
+#endif
+
+HOOK_CALL void *
+operator new(size_t size) NEW_THROW
+{
+    ++allocations;
+    void *ptr = malloc(size ? size : 1);
+    if (ptr == NULL) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+HOOK_CALL void *
+operator new[](size_t size) NEW_THROW
+{
+    return operator new(size);
+}
+
+HOOK_CALL void
+operator delete(void *ptr) DELETE_THROW
+{
+    free(ptr);
+}
+
+HOOK_CALL void
+operator delete[](void *ptr) DELETE_THROW
+{
+    free(ptr);
+}
+
+#if __cpp_sized_deallocation
+// C++14 frees with the size when it is known, the size is not needed here
+HOOK_CALL void
+operator delete(void *ptr, size_t) DELETE_THROW
+{
+    operator delete(ptr);
+}
+
+HOOK_CALL void
+operator delete[](void *ptr, size_t) DELETE_THROW
+{
+    operator delete[](ptr);
+}
+#endif
+
+static double
+monotonicTime()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// CacheCounter_t: hardware cache misses of this thread, if the kernel
+// lets us count them
+class CacheCounter_t {
+public:
+    CacheCounter_t() : _fd(-1) {
+#ifdef __linux__
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        _fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+    }
+    ~CacheCounter_t() {
+#ifdef __linux__
+        if (_fd >= 0) {
+            close(_fd);
+        }
+#endif
+    }
+    bool available() const { return _fd >= 0; }
+    void start() {
+#ifdef __linux__
+        if (_fd >= 0) {
+            ioctl(_fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(_fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+    unsigned long long stop() {
+        unsigned long long count = 0;
+#ifdef __linux__
+        if (_fd >= 0) {
+            ioctl(_fd, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(_fd, &count, sizeof(count)) != sizeof(count)) {
+                count = 0;
+            }
+        }
+#endif
+        return count;
+    }
+private:
+    int _fd;
+};
+
+// RecordedCell_t: a routed cell with the inputs recorded for the kernels
+// router: the cell after routing, its obstacles are the recorded set
+// fresh: the same cell right after construction, fresh.savepoint() is
+//     taken before the routed obstacles are replayed
+// probes: endpoints at contact centres and at points between them
+// escapes: endpoint pairs after the escape process met, with the
+//     intersection point, as routeTwoContacts leaves them
+typedef struct {
+    MemoryBackend_t *backend;
+    Router_t *router;
+    MemoryBackend_t *freshBackend;
+    Router_t *fresh;
+    Router_t::Savepoint_t freshPoint;
+    size_t firstRouted;
+    vector<EndPoint_t> probes;
+    vector<line_t> lines;
+    vector<EndPoint_t> escapes;
+    vector<oaPoint> intersections;
+} RecordedCell_t;
+
+// RouterBench_t: friend of Router_t, holds the recorded cells and the
+// kernels; every kernel runs one pass over all cells and returns the
+// number of operations it did
+class RouterBench_t {
+public:
+    typedef size_t (RouterBench_t::*Kernel_t)();
+
+    RouterBench_t() : _cells(), _counter(), _sink(0) {}
+
+    bool record(const CellSpec_t &spec, const string &dir);
+    void measure(const char *name, Kernel_t kernel, bool reset=false);
+
+    size_t addObstacle();
+    size_t findAround();
+    size_t sameBox();
+    size_t isIntersect();
+    size_t onEscapeLines();
+    size_t getCornerPoints();
+private:
+    void resetFresh();
+    bool escapePair(Router_t &router, EndPoint_t src, EndPoint_t dst, \
+            RecordedCell_t &cell);
+
+    vector<RecordedCell_t> _cells;
+    CacheCounter_t _counter;
+    // sink for results, so the compiler keeps the calls
+    unsigned long _sink;
+};
+
+bool
+RouterBench_t::record(const CellSpec_t &spec, const string &dir)
+{
+    ostringstream name;
+    name << dir << "/micro" << spec.seed;
+    CellGen_t gen(spec);
+    if (!gen.write(name.str())) {
+        cerr << "Cannot write cell: " << name.str() << endl;
+        return false;
+    }
+    RecordedCell_t cell;
+    string file1 = name.str() + ".txt";
+    string file2 = name.str() + ".rule";
+    cell.backend = new MemoryBackend_t(gen.VDDBox(), gen.VSSBox());
+    cell.router = new Router_t(*cell.backend, file1.c_str(), file2.c_str());
+    cell.freshBackend = new MemoryBackend_t(gen.VDDBox(), gen.VSSBox());
+    cell.fresh = new Router_t(*cell.freshBackend, file1.c_str(), file2.c_str());
+    cell.freshPoint = cell.fresh->savepoint();
+    cell.firstRouted = cell.router->_obstacles.size();
+
+    Router_t &router = *cell.router;
+    router.setProbeBudget(10000, 1);
+    if (!router.route()) {
+        router.rerouteFailedNets();
+    }
+
+    // probes at the contact centres and halfway to the next contact
+    const DRC_t &rule = router._designRule;
+    NetSet_t::const_iterator netIter;
+    for (netIter = router._nets.begin(); netIter != router._nets.end(); ++netIter) {
+        for (size_t i = 0; i < netIter->size(); ++i) {
+            oaCoord x = (*netIter)[i].x() + rule.viaWidth() / 2;
+            oaCoord y = (*netIter)[i].y() + rule.viaHeight() / 2;
+            cell.probes.push_back(EndPoint_t(x, y, netIter->id()));
+            if (i + 1 < netIter->size()) {
+                oaCoord x2 = (*netIter)[i + 1].x() + rule.viaWidth() / 2;
+                oaCoord y2 = (*netIter)[i + 1].y() + rule.viaHeight() / 2;
+                cell.probes.push_back(EndPoint_t((x + x2) / 2, (y + y2) / 2, \
+                        netIter->id()));
+                escapePair(router, EndPoint_t(x, y, netIter->id()), \
+                        EndPoint_t(x2, y2, netIter->id()), cell);
+            }
+        }
+    }
+    // escape lines through every probe
+    vector<EndPoint_t>::const_iterator probeIter;
+    for (probeIter = cell.probes.begin(); probeIter != cell.probes.end(); ++probeIter) {
+        line_t line;
+        router.getEscapeLine(*probeIter, HORIZONTAL, line);
+        cell.lines.push_back(line);
+        router.getEscapeLine(*probeIter, VERTICAL, line);
+        cell.lines.push_back(line);
+    }
+    _cells.push_back(cell);
+    return true;
+}
+
+// run the escape loop of routeTwoContacts on a routed cell and keep the
+// endpoints if they meet
+bool
+RouterBench_t::escapePair(Router_t &router, EndPoint_t src, EndPoint_t dst, \
+        RecordedCell_t &cell)
+{
+    EndPoint_t *lhs = &src;
+    EndPoint_t *rhs = &dst;
+    oaPoint intersectionPoint;
+    bool intersect = false;
+    for (int probe = 0; probe < 200 && !intersect; ++probe) {
+        if (lhs->noEscape()) {
+            if (rhs->noEscape()) {
+                return false;
+            }
+            swap(lhs, rhs);
+            intersect = router.escape(*lhs, *rhs, intersectionPoint);
+        }
+        else {
+            intersect = router.escape(*lhs, *rhs, intersectionPoint);
+            swap(lhs, rhs);
+        }
+    }
+    if (!intersect) {
+        return false;
+    }
+    cell.escapes.push_back(*lhs);
+    cell.intersections.push_back(intersectionPoint);
+    cell.escapes.push_back(*rhs);
+    cell.intersections.push_back(intersectionPoint);
+    return true;
+}
+
+void
+RouterBench_t::resetFresh()
+{
+    vector<RecordedCell_t>::iterator cellIter;
+    for (cellIter = _cells.begin(); cellIter != _cells.end(); ++cellIter) {
+        cellIter->fresh->rollback(cellIter->freshPoint);
+    }
+}
+
+// Run passes of kernel until 0.2 s are spent, reset undoes the state a
+// pass leaves behind and is not timed.
+void
+RouterBench_t::measure(const char *name, Kernel_t kernel, bool reset)
+{
+    // warm up
+    if (reset) {
+        resetFresh();
+    }
+    (this->*kernel)();
+
+    double seconds = 0;
+    unsigned long long ops = 0;
+    unsigned long long misses = 0;
+    unsigned long allocs = 0;
+    while (seconds < 0.2) {
+        if (reset) {
+            resetFresh();
+        }
+        unsigned long allocsBefore = allocations;
+        _counter.start();
+        double start = monotonicTime();
+        ops += (this->*kernel)();
+        seconds += monotonicTime() - start;
+        misses += _counter.stop();
+        allocs += allocations - allocsBefore;
+        if (ops == 0) {
+            break;
+        }
+    }
+    cout << setw(16) << left << name << right << setw(12) << ops;
+    if (ops == 0) {
+        cout << "  no operations recorded" << endl;
+        return;
+    }
+    cout << setw(12) << fixed << setprecision(1) << seconds * 1e9 / ops;
+    cout << setw(12) << setprecision(3) << static_cast<double>(allocs) / ops;
+    if (_counter.available()) {
+        cout << setw(14) << setprecision(3) << static_cast<double>(misses) / ops;
+    }
+    else {
+        cout << setw(14) << "n/a";
+    }
+    cout << endl;
+}
+
+// replay the obstacles added while routing onto the freshly built cell
+size_t
+RouterBench_t::addObstacle()
+{
+    size_t ops = 0;
+    vector<RecordedCell_t>::iterator cellIter;
+    for (cellIter = _cells.begin(); cellIter != _cells.end(); ++cellIter) {
+        const vector<Router_t::Obstacle_t> &obstacles = cellIter->router->_obstacles;
+        for (size_t i = cellIter->firstRouted; i < obstacles.size(); ++i) {
+            cellIter->fresh->addObstacle(obstacles[i].layer, obstacles[i].netID, \
+                    obstacles[i].box);
+            ++ops;
+        }
+    }
+    return ops;
+}
+
+// the barrier index query behind coversAt, both directions of both layers
+size_t
+RouterBench_t::findAround()
+{
+    size_t ops = 0;
+    vector<RecordedCell_t>::iterator cellIter;
+    for (cellIter = _cells.begin(); cellIter != _cells.end(); ++cellIter) {
+        Router_t &router = *cellIter->router;
+        vector<EndPoint_t>::const_iterator probeIter;
+        for (probeIter = cellIter->probes.begin(); probeIter != cellIter->probes.end(); \
+                ++probeIter) {
+            const oaPoint &point = probeIter->getObjectPoint();
+            line_t before, after;
+            router._m2Barriers.findAround(point.x(), point.y(), probeIter->netID(), \
+                    before, after);
+            _sink += before.first.x() + after.first.x();
+            router._m1Barriers.findAround(point.y(), point.x(), probeIter->netID(), \
+                    before, after);
+            _sink += before.first.y() + after.first.y();
+            ops += 2;
+        }
+    }
+    return ops;
+}
+
+size_t
+RouterBench_t::sameBox()
+{
+    size_t ops = 0;
+    vector<RecordedCell_t>::iterator cellIter;
+    for (cellIter = _cells.begin(); cellIter != _cells.end(); ++cellIter) {
+        Router_t &router = *cellIter->router;
+        vector<EndPoint_t>::const_iterator probeIter;
+        for (probeIter = cellIter->probes.begin(); probeIter != cellIter->probes.end(); \
+                ++probeIter) {
+            line_t covers[4];
+            router.coversAt(probeIter->getObjectPoint(), probeIter->netID(), covers);
+            _sink += router.sameBox(covers[Router_t::LEFT], covers[Router_t::RIGHT]);
+            _sink += router.sameBox(covers[Router_t::BOTTOM], covers[Router_t::TOP]);
+            ops += 2;
+        }
+    }
+    return ops;
+}
+
+// every recorded escape line against every recorded endpoint of the cell
+size_t
+RouterBench_t::isIntersect()
+{
+    size_t ops = 0;
+    vector<RecordedCell_t>::iterator cellIter;
+    for (cellIter = _cells.begin(); cellIter != _cells.end(); ++cellIter) {
+        vector<EndPoint_t>::const_iterator endIter;
+        for (endIter = cellIter->escapes.begin(); endIter != cellIter->escapes.end(); \
+                ++endIter) {
+            vector<line_t>::const_iterator lineIter;
+            for (lineIter = cellIter->lines.begin(); lineIter != cellIter->lines.end(); \
+                    ++lineIter) {
+                oaPoint intersectionPoint;
+                _sink += endIter->isIntersect(*lineIter, intersectionPoint);
+                ++ops;
+            }
+        }
+    }
+    return ops;
+}
+
+// the probe points against the escape lines of every recorded endpoint
+size_t
+RouterBench_t::onEscapeLines()
+{
+    size_t ops = 0;
+    vector<RecordedCell_t>::iterator cellIter;
+    for (cellIter = _cells.begin(); cellIter != _cells.end(); ++cellIter) {
+        vector<EndPoint_t>::const_iterator endIter;
+        for (endIter = cellIter->escapes.begin(); endIter != cellIter->escapes.end(); \
+                ++endIter) {
+            vector<EndPoint_t>::const_iterator probeIter;
+            for (probeIter = cellIter->probes.begin(); \
+                    probeIter != cellIter->probes.end(); ++probeIter) {
+                _sink += endIter->onEscapeLines(probeIter->getObjectPoint(), HORIZONTAL);
+                _sink += endIter->onEscapeLines(probeIter->getObjectPoint(), VERTICAL);
+                ops += 2;
+            }
+        }
+    }
+    return ops;
+}
+
+size_t
+RouterBench_t::getCornerPoints()
+{
+    size_t ops = 0;
+    vector<RecordedCell_t>::iterator cellIter;
+    for (cellIter = _cells.begin(); cellIter != _cells.end(); ++cellIter) {
+        for (size_t i = 0; i < cellIter->escapes.size(); ++i) {
+            EndPoint_t &endPoint = cellIter->escapes[i];
+            endPoint.cornerPoints().clear();
+            endPoint.getCornerPoints(cellIter->intersections[i]);
+            _sink += endPoint.cornerPoints().size();
+            ++ops;
+        }
+    }
+    return ops;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 4) {
+        cerr << "Usage: ./microbench [cells [seed [dir]]]." << endl;
+        return 1;
+    }
+    unsigned cells = (argc > 1) ? atoi(argv[1]) : 6;
+    unsigned seed = (argc > 2) ? atoi(argv[2]) : 1;
+    string dir = (argc > 3) ? argv[3] : "bench/corpus";
+
+    // the router prints its progress on cout, keep it out of the report
+    ofstream devNull("/dev/null");
+    streambuf *report = cout.rdbuf();
+    cout.rdbuf(devNull.rdbuf());
+
+    RouterBench_t bench;
+    for (unsigned i = 0; i < cells; ++i) {
+        CellSpec_t spec;
+        spec.seed = seed + i;
+        spec.columns = 16 + 8 * (i % 3);
+        spec.density = 0.6 + 0.1 * (i % 3);
+        spec.ioFraction = 0.3;
+        spec.maxPins = 4;
+        spec.pitch = 1.0;
+        if (!bench.record(spec, dir)) {
+            return 1;
+        }
+    }
+    cout.rdbuf(report);
+
+    cout << setw(16) << left << "primitive" << right << setw(12) << "ops";
+    cout << setw(12) << "ns/op" << setw(12) << "allocs/op" << setw(14) << "misses/op" << endl;
+    bench.measure("addObstacle", &RouterBench_t::addObstacle, true);
+    bench.measure("findAround", &RouterBench_t::findAround);
+    bench.measure("sameBox", &RouterBench_t::sameBox);
+    bench.measure("isIntersect", &RouterBench_t::isIntersect);
+    bench.measure("onEscapeLines", &RouterBench_t::onEscapeLines);
+    bench.measure("getCornerPoints", &RouterBench_t::getCornerPoints);
+    return 0;
+}
@@ -1,6 +1,6 @@
 #include <iostream>
 #include "line.h"
-#include "oaDesignDB.h"
+#include "Geometry.h"
 
 using namespace std;
 using namespace oa;
@@ -2,7 +2,7 @@
 #define LINE_H_
 
 #include <utility>
-#include "oaDesignDB.h"
+#include "Geometry.h"
 
 // line_t: line segment in line-probing algorithm
 class line_t : public std::pair<oa::oaPoint, oa::oaPoint> {
@@ -1,124 +1,513 @@
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <cerrno>
 #include "oaDesignDB.h"
 #include "Router.h"
+#include "OaBackend.h"
+#include "Scheduler.h"
+#include "Trace.h"
+#include "Log.h"
 
 using namespace std;
 using namespace oa;
 
+// CellJob_t: one line of a batch manifest and its outcome. design,
+// backend and router live from prepareCell() to commitCell(), log holds what the
+// routing stage would have printed and report the cell's JSON report.
+typedef struct {
+    string inputCell;
+    string outputCell;
+    string connectionFile;
+    string ruleFile;
+    oaDesign *design;
+    OaBackend_t *backend;
+    Router_t *router;
+    string log;
+    string report;
+    bool routed;
+    double seconds;
+} CellJob_t;
+
+static double
+wallTime()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+// find, open or create the library and add it to the lib def list
+static oaLib *
+openLibrary(const oaScalarName &libraryName, const oaString &libraryPath)
+{
+    // open the libs defined in "lib.def"
+    oaLibDefList::openLibs();
+
+    // locate the library
+    oaLib *lib = oaLib::find(libraryName);
+
+    if (!lib) {
+        if (oaLib::exists(libraryPath)) {
+            lib = oaLib::open(libraryName, libraryPath);
+        }
+        else {
+            lib = oaLib::create(libraryName, libraryPath);
+        }
+        if (lib) {
+            // update the lib def list
+            oaLibDefList *list = oaLibDefList::getTopList();
+            if (list) {
+                oaString topListPath;
+                list->getPath(topListPath);
+                list->get(topListPath, 'a');
+                oaLibDef::create(list, libraryName, libraryPath);
+                list->save();
+            }
+        }
+    }
+    return lib;
+}
+
+// Open the cell, save it as job.outputCell and read its nets and rules.
+// OA is not thread-safe, so this runs on the main thread only.
+static bool
+prepareCell(oaTech *tech, const oaScalarName &libraryName, CellJob_t &job, \
+        oaUInt4 maxProbes, double maxSeconds, Router_t::Engine_t engine, RouteCache_t *cache, \
+        unsigned portfolio, bool patternRouting)
+{
+    oaNativeNS oaNs;
+    oaScalarName cellName(oaNs, job.inputCell.c_str());
+    oaScalarName newCellName(oaNs, job.outputCell.c_str());
+    oaScalarName layoutView(oaNs, "layout");
+
+    cout << "Routing Cell: " << job.inputCell << endl;
+    cout << "Output Cell: " << job.outputCell << endl;
+    cout << "Connection file: " << job.connectionFile << endl;
+    cout << "Design rule file: " << job.ruleFile << endl;
+
+    // read connection file and design rule file first, a ParseError_t
+    // leaves no design open
+    double start = wallTime();
+    NetSet_t nets(job.connectionFile.c_str());
+    DRC_t designRule(job.ruleFile.c_str());
+    double parseSeconds = wallTime() - start;
+
+    // open the design now
+    job.design = oaDesign::open(libraryName, cellName, layoutView, 'r');
+
+    job.design->saveAs(libraryName, newCellName, layoutView);
+    oaScalarName name_buffer;
+    oaString string_buffer;
+    job.design->getLibName(name_buffer);
+    name_buffer.get(oaNs,string_buffer);
+    cout << "The library name for this design is : " << string_buffer << endl;
+
+    job.design->getCellName(name_buffer);
+    name_buffer.get(oaNs,string_buffer);
+    cout << "The cell name for this design is : " << string_buffer << endl;
+
+    job.design->getViewName(name_buffer);
+    name_buffer.get(oaNs,string_buffer);
+    cout << "The view name for this design is : " << string_buffer << endl;
+
+    job.backend = new OaBackend_t(job.design, tech);
+    job.router = new Router_t(*job.backend, nets, designRule);
+    job.router->setProbeBudget(maxProbes, maxSeconds);
+    job.router->setEngine(engine);
+    job.router->setCache(cache);
+    job.router->setPortfolio(portfolio);
+    job.router->setPatternRouting(patternRouting);
+    job.router->stats().addPhase("parse", parseSeconds);
+    // keep the router's messages under this cell's header
+    logFlush();
+    return true;
+}
+
+// CellWindow_t: the cells routed by one Scheduler_t::run, indices into
+// jobs
+typedef struct {
+    vector<CellJob_t> *jobs;
+    vector<size_t> cells;
+} CellWindow_t;
+
+// Route one prepared cell. Routing only writes to the router's own
+// journal, so cells are routed concurrently by the scheduler threads.
+static void
+routeJob(size_t index, void *context)
+{
+    CellWindow_t &window = *static_cast<CellWindow_t *>(context);
+    CellJob_t &job = (*window.jobs)[window.cells[index]];
+    if (job.router == NULL) {
+        return;
+    }
+    double start = wallTime();
+    Router_t &router = *job.router;
+    ostringstream log;
+
+    // start routing
+    job.routed = true;
+    if (router.route()) {
+        log << "Routing succeeded without violation." << endl;
+    } else if (router.rerouteFailedNets()) {
+        log << "Routing succeeded after rerouting the failed nets." << endl;
+    } else {
+        router.reRoute();
+        log << "Routing failed with some violations." << endl;
+        job.routed = false;
+    }
+    vector<ConnectionFailure_t>::const_iterator failIter;
+    for (failIter = router.failures().begin(); \
+            failIter != router.failures().end(); ++failIter) {
+        log << "Failed connection in net " << failIter->netID << ": (";
+        log << failIter->from.x() << ", " << failIter->from.y() << ") - (";
+        log << failIter->to.x() << ", " << failIter->to.y() << "), ";
+        log << Router_t::failReasonName(failIter->reason) << endl;
+    }
+    job.log = log.str();
+    job.seconds += wallTime() - start;
+}
+
+// Write the routed shapes of a cell into its design and save it, on the
+// main thread again.
+static void
+commitCell(const oaScalarName &libraryName, CellJob_t &job)
+{
+    oaNativeNS oaNs;
+    oaScalarName newCellName(oaNs, job.outputCell.c_str());
+    oaScalarName layoutView(oaNs, "layout");
+
+    cout << job.outputCell << ": " << job.log;
+    job.router->commit();
+    double start = wallTime();
+    job.design->saveAs(libraryName, newCellName, layoutView);
+    job.router->stats().addPhase("save", wallTime() - start);
+    job.design->close();
+
+    ostringstream report;
+    report << "    {\"cell\": ";
+    RouterStats_t::writeString(report, job.inputCell);
+    report << ", \"output\": ";
+    RouterStats_t::writeString(report, job.outputCell);
+    report << ", \"routed\": " << (job.routed ? "true" : "false");
+    report << ", \"cached\": " << (job.router->cached() ? "true" : "false");
+    report << ", \"probes\": " << job.router->totalProbes() << "," << endl;
+    job.router->stats().writeJson(report, 6);
+    report << "    }";
+    job.report = report.str();
+}
+
+static void
+releaseCell(CellJob_t &job)
+{
+    delete job.router;
+    delete job.backend;
+    job.router = NULL;
+    job.backend = NULL;
+    job.design = NULL;
+}
+
+// Read a manifest with one cell per line:
+// input_cell output_cell connection_file design_rule_file
+// Empty lines and lines starting with '#' are skipped.
+static bool
+readManifest(const char *fileName, vector<CellJob_t> &jobs)
+{
+    ifstream file(fileName);
+    if (!file.good()) {
+        cerr << "Cannot open file: " << fileName << endl;
+        return false;
+    }
+    string line;
+    unsigned lineNo = 0;
+    while (getline(file, line)) {
+        ++lineNo;
+        istringstream fields(line);
+        CellJob_t job;
+        if (!(fields >> job.inputCell) || job.inputCell[0] == '#') {
+            continue;
+        }
+        if (!(fields >> job.outputCell >> job.connectionFile >> job.ruleFile)) {
+            cerr << fileName << ":" << lineNo << ": expected input_cell";
+            cerr << " output_cell connection_file design_rule_file" << endl;
+            return false;
+        }
+        job.design = NULL;
+        job.backend = NULL;
+        job.router = NULL;
+        job.routed = false;
+        job.seconds = 0;
+        jobs.push_back(job);
+    }
+    return true;
+}
+
+// order cells by decreasing contact count, read from their connection
+// files; a file that does not parse counts 0 and fails in prepareCell
+class ContactsGreater {
+public:
+    ContactsGreater(const vector<double> &costs) : _costs(costs) {}
+    bool operator()(size_t lhs, size_t rhs) const {
+        return _costs[lhs] > _costs[rhs];
+    }
+private:
+    const vector<double> &_costs;
+};
+
+static void
+longestFirst(const vector<CellJob_t> &jobs, vector<double> &costs, vector<size_t> &order)
+{
+    costs.assign(jobs.size(), 0);
+    order.resize(jobs.size());
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        order[i] = i;
+        try {
+            costs[i] = NetSet_t(jobs[i].connectionFile.c_str()).contactCount();
+        }
+        catch (ParseError_t &) {
+        }
+    }
+    stable_sort(order.begin(), order.end(), ContactsGreater(costs));
+}
+
+// write the reports of all cells as {"cells": [...]}
+static bool
+writeReport(const char *fileName, const vector<CellJob_t> &jobs)
+{
+    ofstream file(fileName);
+    if (!file.good()) {
+        cerr << "Cannot open file: " << fileName << endl;
+        return false;
+    }
+    file << "{" << endl << "  \"cells\": [";
+    bool first = true;
+    vector<CellJob_t>::const_iterator jobIter;
+    for (jobIter = jobs.begin(); jobIter != jobs.end(); ++jobIter) {
+        if (jobIter->report.empty()) {
+            continue;
+        }
+        file << (first ? "" : ",") << endl << jobIter->report;
+        first = false;
+    }
+    file << endl << "  ]" << endl << "}" << endl;
+    return file.good();
+}
+
 int main(int argc, char *argv[])
 {
-    if (argc != 5) {
-        cerr << "Usage: ./main input_cell output_cell Connection_file";
-        cerr << " Design rule file." << endl;
+    // leading options of both modes, in any order:
+    // -report file: write the JSON report
+    // -engine probe|tile|fallback|grid|race: see Router_t::Engine_t
+    // -cache dir: reuse the routes of cells with the same geometry
+    // -portfolio workers: net orderings tried at once per cell
+    // -nopattern: leave every connection to the engine, no L/Z routes
+    const char *reportFile = NULL;
+    const char *cacheDir = NULL;
+    unsigned portfolio = 0;
+    bool patternRouting = true;
+    Router_t::Engine_t engine = Router_t::PROBE_ENGINE;
+    while ((argc > 1 && strcmp(argv[1], "-nopattern") == 0) || \
+            (argc > 2 && (strcmp(argv[1], "-report") == 0 || strcmp(argv[1], "-engine") == 0 || \
+                strcmp(argv[1], "-cache") == 0 || strcmp(argv[1], "-portfolio") == 0))) {
+        if (strcmp(argv[1], "-nopattern") == 0) {
+            patternRouting = false;
+            argv[1] = argv[0];
+            --argc;
+            ++argv;
+            continue;
+        }
+        if (strcmp(argv[1], "-report") == 0) {
+            reportFile = argv[2];
+        }
+        else if (strcmp(argv[1], "-cache") == 0) {
+            cacheDir = argv[2];
+        }
+        else if (strcmp(argv[1], "-portfolio") == 0) {
+            portfolio = atoi(argv[2]);
+        }
+        else if (!Router_t::parseEngine(argv[2], engine)) {
+            cerr << "Unknown engine: " << argv[2] << endl;
+            return 1;
+        }
+        argv[2] = argv[0];
+        argc -= 2;
+        argv += 2;
+    }
+    bool batch = (argc > 1 && strcmp(argv[1], "-batch") == 0);
+    int budgetArg = batch ? 3 : 5;
+    unsigned threads = 1;
+    if (batch && argc > 4 && strcmp(argv[3], "-j") == 0) {
+        threads = atoi(argv[4]);
+        budgetArg = 5;
+    }
+    if ((batch && (argc < 3 || argc > budgetArg + 2)) || \
+            (!batch && (argc < 5 || argc > 7))) {
+        cerr << "Usage: ./main [options] input_cell output_cell";
+        cerr << " Connection_file Design rule file [max_probes [max_seconds]]." << endl;
+        cerr << "       ./main [options] -batch manifest [-j threads]";
+        cerr << " [max_probes [max_seconds]]." << endl;
+        cerr << "Options: -report file, -engine name, -cache dir, -portfolio workers,";
+        cerr << " -nopattern." << endl;
         return 1;
     }
-    cout << "Routing Cell: " << argv[1] << endl;
-    cout << "Output Cell: " << argv[2] << endl;
-    cout << "Connection file: " << argv[3] << endl;
-    cout << "Design rule file: " << argv[4] << endl;
+
+    vector<CellJob_t> jobs;
+    if (batch) {
+        if (!readManifest(argv[2], jobs)) {
+            return 1;
+        }
+    }
+    else {
+        CellJob_t job;
+        job.inputCell = argv[1];
+        job.outputCell = argv[2];
+        job.connectionFile = argv[3];
+        job.ruleFile = argv[4];
+        job.design = NULL;
+        job.backend = NULL;
+        job.router = NULL;
+        job.routed = false;
+        job.seconds = 0;
+        jobs.push_back(job);
+    }
+    // per-connection budget, 0 means no limit
+    oaUInt4 maxProbes = (argc > budgetArg) ? atoi(argv[budgetArg]) : \
+                        Router_t::DEFAULT_MAX_PROBES;
+    double maxSeconds = (argc > budgetArg + 1) ? atof(argv[budgetArg + 1]) : \
+                        Router_t::DEFAULT_MAX_SECONDS;
+
+    RouteCache_t *cache = NULL;
+    if (cacheDir != NULL) {
+        if (mkdir(cacheDir, 0777) != 0 && errno != EEXIST) {
+            cerr << "Cannot create directory: " << cacheDir << endl;
+            return 1;
+        }
+        cache = new RouteCache_t(cacheDir);
+    }
+
+    Scheduler_t scheduler(threads);
     try {
+        // OA, the library and the tech are opened once for all cells
         oaDesignInit(oacAPIMajorRevNumber, oacAPIMinorRevNumber, 3);
 
         oaNativeNS oaNs;
         oaString libraryPath("./DesignLib");
         oaString library("DesignLib");
-        oaString top_cell(argv[1]);
-        oaString new_top_cell(argv[2]);
-        oaString layout_view("layout");
         oaScalarName libraryName(oaNs, library);
-        oaScalarName cellName(oaNs, top_cell);
-        oaScalarName newCellName(oaNs, new_top_cell);
-        oaScalarName layoutView(oaNs, layout_view);
-
-        // open the libs defined in "lib.def"
-        oaLibDefList::openLibs();
-
-        // locate the library
-        oaLib *lib = oaLib::find(libraryName);
 
+        oaLib *lib = openLibrary(libraryName, libraryPath);
         if (!lib) {
-            if (oaLib::exists(libraryPath)) {
-                lib = oaLib::open(libraryName, libraryPath);
-            }
-            else {
-                lib = oaLib::create(libraryName, libraryPath);
-            }
-            if (lib) {
-                // update the lib def list
-                oaLibDefList *list = oaLibDefList::getTopList();
-                if (list) {
-                    oaString topListPath;
-                    list->getPath(topListPath);
-                    list->get(topListPath, 'a');
-                    oaLibDef *newLibDef = oaLibDef::create(list, libraryName, libraryPath);
-                    list->save();
-                }
-            }
-            else {
-                cerr << "Error: Unable to create " << libraryPath << "/";
-                cerr << library << endl;
-                return 1;
-            }
+            cerr << "Error: Unable to create " << libraryPath << "/";
+            cerr << library << endl;
+            return 1;
         }
 
-        // open the design now
-        oaDesign *design = oaDesign::open(libraryName, cellName, layoutView, 'r');
-
-        design->saveAs(libraryName, newCellName, layoutView);
-        oaScalarName name_buffer;
-        oaString string_buffer;
-        design->getLibName(name_buffer);
-        name_buffer.get(oaNs,string_buffer);
-        cout << "The library name for this design is : " << string_buffer << endl;
-
-        design->getCellName(name_buffer);
-        name_buffer.get(oaNs,string_buffer);
-        cout << "The cell name for this design is : " << string_buffer << endl;
-
-        design->getViewName(name_buffer);
-        name_buffer.get(oaNs,string_buffer);
-        cout << "The view name for this design is : " << string_buffer << endl;
-
         // open oaTech
         oaTech *tech = oaTech::open(lib, 'a');
 
-        // read connection file and design rule file
-        ifstream file1, file2;
-
-        file1.open(argv[3]);
-        if (!file1.good()) {
-            cerr << "Cannot open file: " << argv[3] << endl;
-            exit(1);
-        }
-        file2.open(argv[4]);
-        if (!file2.good()) {
-            cerr << "Cannot open file: " << argv[4] << endl;
-            exit(1);
-        }
-
-        Router_t router(design, tech, file1, file2);
+        // Cells go through in windows of a few per thread, longest first:
+        // open the designs and read the inputs (serial), route them (in
+        // parallel), write the shapes and save the designs (serial). Only
+        // one window of designs and routers is alive at a time.
+        vector<double> costs;
+        vector<size_t> order;
+        longestFirst(jobs, costs, order);
+        size_t windowSize = 4 * scheduler.threads();
+        double routeSeconds = 0;
+        for (size_t next = 0; next < order.size(); ) {
+            CellWindow_t window;
+            window.jobs = &jobs;
+            vector<double> windowCosts;
+            for (; next < order.size() && window.cells.size() < windowSize; ++next) {
+                CellJob_t &job = jobs[order[next]];
+                double start = wallTime();
+                try {
+                    if (prepareCell(tech, libraryName, job, maxProbes, maxSeconds, engine, \
+                                cache, portfolio, patternRouting)) {
+                        window.cells.push_back(order[next]);
+                        windowCosts.push_back(costs[order[next]]);
+                    }
+                }
+                catch (oaException &excp) {
+                    if (!batch) {
+                        throw;
+                    }
+                    cout << "ERROR: " << job.inputCell << ": " << excp.getMsg() << endl;
+                    releaseCell(job);
+                }
+                catch (ParseError_t &excp) {
+                    cout << "ERROR: " << excp.what() << endl;
+                    if (!batch) {
+                        return 1;
+                    }
+                }
+                job.seconds = wallTime() - start;
+            }
 
-        file1.close();
-        file2.close();
+            double routeStart = wallTime();
+            scheduler.run(windowCosts, routeJob, &window);
+            routeSeconds += wallTime() - routeStart;
+            logFlush();
 
-        // start routing
-        if (router.route()) {
-            cout << "Routing succeeded without violation." << endl;
-        } else {
-            router.reRoute();
-            cout << "Routing failed with some violations." << endl;
+            vector<size_t>::const_iterator cellIter;
+            for (cellIter = window.cells.begin(); cellIter != window.cells.end(); ++cellIter) {
+                CellJob_t &job = jobs[*cellIter];
+                double start = wallTime();
+                try {
+                    commitCell(libraryName, job);
+                }
+                catch (oaException &excp) {
+                    if (!batch) {
+                        throw;
+                    }
+                    cout << "ERROR: " << job.inputCell << ": " << excp.getMsg() << endl;
+                    job.routed = false;
+                }
+                releaseCell(job);
+                job.seconds += wallTime() - start;
+            }
+        }
+        if (batch) {
+            cout << "Routing stage: " << routeSeconds << "s on ";
+            cout << scheduler.threads() << " threads" << endl;
         }
 
-        // save the design
-        design->saveAs(libraryName, newCellName, layoutView);
         // save the tech with new created layers
         tech->save();
-        design->close();
     }
     catch (oaException &excp) {
         cout << "ERROR: " << excp.getMsg() << endl;
         exit(1);
     }
+
+    ROUTER_TRACE_DUMP(NULL);
+    if (reportFile != NULL && !writeReport(reportFile, jobs)) {
+        return 1;
+    }
+    if (batch) {
+        unsigned passed = 0;
+        double total = 0;
+        vector<CellJob_t>::const_iterator jobIter;
+        cout << "Batch summary:" << endl;
+        for (jobIter = jobs.begin(); jobIter != jobs.end(); ++jobIter) {
+            cout << (jobIter->routed ? "PASS " : "FAIL ") << jobIter->inputCell;
+            cout << " -> " << jobIter->outputCell << " " << jobIter->seconds << "s" << endl;
+            passed += jobIter->routed ? 1 : 0;
+            total += jobIter->seconds;
+        }
+        cout << passed << "/" << jobs.size() << " cells routed in " << total << "s" << endl;
+        if (cache != NULL) {
+            cout << "Route cache: " << cache->hits() << " hits, " << cache->misses();
+            cout << " misses" << endl;
+        }
+    }
+    delete cache;
     return 0;
 }
@@ -0,0 +1,229 @@
+// barrierindex: check BarrierIndex_t against the plain walk over a
+// coordinate-sorted multimap it replaced, on random barrier sets with
+// inserts, erased nets and copies interleaved with the queries
+#include <iostream>
+#include <map>
+#include <cstdlib>
+#include "BarrierIndex.h"
+
+using namespace oa;
+using namespace std;
+
+typedef multimap<oaCoord, pair<oaInt4, line_t> > BarrierMap_t;
+
+// the reference: barrier segments run from (coord, low) to (coord, high),
+// their x is replaced by the insertion number to tell them apart
+class Reference_t {
+public:
+    explicit Reference_t(oaInt4 margin) : _margin(margin) {}
+    void insert(oaCoord coord, oaInt4 netID, const line_t &seg) {
+        _barriers.insert(make_pair(coord, make_pair(netID, seg)));
+    }
+    void eraseNet(oaInt4 netID);
+    bool findBefore(oaCoord pos, oaCoord across, oaInt4 excludeNet, line_t &seg) const;
+    bool findAfter(oaCoord pos, oaCoord across, oaInt4 excludeNet, line_t &seg) const;
+    bool nextCoord(oaCoord pos, int dir, oaCoord &next) const;
+    bool nextSpanBound(oaCoord across, int dir, oaCoord &next) const;
+    size_t size() const { return _barriers.size(); }
+private:
+    bool covers(const line_t &seg, oaCoord across) const {
+        return seg.first.y() - _margin < across && across < seg.second.y() + _margin;
+    }
+    oaInt4 _margin;
+    BarrierMap_t _barriers;
+};
+
+void
+Reference_t::eraseNet(oaInt4 netID)
+{
+    BarrierMap_t::iterator it = _barriers.begin();
+    while (it != _barriers.end()) {
+        if (it->second.first == netID) {
+            _barriers.erase(it++);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+bool
+Reference_t::findBefore(oaCoord pos, oaCoord across, oaInt4 excludeNet, \
+        line_t &seg) const
+{
+    BarrierMap_t::const_iterator it = _barriers.lower_bound(pos);
+    while (it != _barriers.begin()) {
+        --it;
+        if (it->second.first != excludeNet && covers(it->second.second, across)) {
+            seg = it->second.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool
+Reference_t::findAfter(oaCoord pos, oaCoord across, oaInt4 excludeNet, \
+        line_t &seg) const
+{
+    BarrierMap_t::const_iterator it;
+    for (it = _barriers.upper_bound(pos); it != _barriers.end(); ++it) {
+        if (it->second.first != excludeNet && covers(it->second.second, across)) {
+            seg = it->second.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool
+Reference_t::nextCoord(oaCoord pos, int dir, oaCoord &next) const
+{
+    bool found = false;
+    BarrierMap_t::const_iterator it;
+    for (it = _barriers.begin(); it != _barriers.end(); ++it) {
+        oaCoord coord = it->first;
+        if ((dir > 0 ? coord > pos : coord < pos) && \
+                (!found || (dir > 0 ? coord < next : coord > next))) {
+            next = coord;
+            found = true;
+        }
+    }
+    return found;
+}
+
+bool
+Reference_t::nextSpanBound(oaCoord across, int dir, oaCoord &next) const
+{
+    bool found = false;
+    BarrierMap_t::const_iterator it;
+    for (it = _barriers.begin(); it != _barriers.end(); ++it) {
+        oaCoord bounds[2] = { it->second.second.first.y() - _margin, \
+                              it->second.second.second.y() + _margin };
+        for (int i = 0; i < 2; ++i) {
+            if ((dir > 0 ? bounds[i] > across : bounds[i] < across) && \
+                    (!found || (dir > 0 ? bounds[i] < next : bounds[i] > next))) {
+                next = bounds[i];
+                found = true;
+            }
+        }
+    }
+    return found;
+}
+
+static int failures = 0;
+
+static void
+expect(bool ok, const char *what, int trial, oaCoord pos, oaCoord across, oaInt4 net)
+{
+    if (!ok) {
+        if (failures < 10) {
+            cerr << "trial " << trial << ": " << what << " differs at pos " << pos \
+                 << " across " << across << " net " << net << endl;
+        }
+        ++failures;
+    }
+}
+
+static bool
+sameResult(bool lhsFound, const line_t &lhs, bool rhsFound, const line_t &rhs)
+{
+    return lhsFound == rhsFound && (!lhsFound || lhs == rhs);
+}
+
+// random queries against both
+static void
+query(const Reference_t &reference, const BarrierIndex_t &index, int trial, \
+        oaCoord range, int count)
+{
+    for (int q = 0; q < count; ++q) {
+        oaCoord pos = rand() % (range + 20) - 10;
+        oaCoord across = rand() % (range + 60) - 30;
+        oaInt4 net = rand() % 6 - 1;
+        line_t expected, found;
+        bool expectedFound = reference.findBefore(pos, across, net, expected);
+        bool indexFound = index.findBefore(pos, across, net, found);
+        expect(sameResult(expectedFound, expected, indexFound, found), "findBefore", \
+                trial, pos, across, net);
+        line_t expectedAfter, foundAfter;
+        bool expectedAfterFound = reference.findAfter(pos, across, net, expectedAfter);
+        indexFound = index.findAfter(pos, across, net, foundAfter);
+        expect(sameResult(expectedAfterFound, expectedAfter, indexFound, foundAfter), \
+                "findAfter", trial, pos, across, net);
+
+        line_t before, after;
+        index.findAround(pos, across, net, before, after);
+        expect(sameResult(expectedFound, expected, expectedFound, before) && \
+                sameResult(expectedAfterFound, expectedAfter, expectedAfterFound, after), \
+                "findAround", trial, pos, across, net);
+
+        int dir = (rand() % 2) ? 1 : -1;
+        oaCoord expectedNext = 0, next = 0;
+        expectedFound = reference.nextCoord(pos, dir, expectedNext);
+        indexFound = index.nextCoord(pos, dir, next);
+        expect(expectedFound == indexFound && (!indexFound || expectedNext == next), \
+                "nextCoord", trial, pos, across, net);
+        expectedFound = reference.nextSpanBound(across, dir, expectedNext);
+        indexFound = index.nextSpanBound(across, dir, next);
+        expect(expectedFound == indexFound && (!indexFound || expectedNext == next), \
+                "nextSpanBound", trial, pos, across, net);
+    }
+}
+
+int
+main()
+{
+    srand(1);
+    int barriers = 0;
+    for (int trial = 0; trial < 200; ++trial) {
+        // small ranges give many equal coordinates and nested spans
+        oaCoord range = (trial % 2) ? 200 : 5000;
+        oaInt4 margin = rand() % 12;
+        Reference_t reference(margin);
+        BarrierIndex_t index;
+        index.setMargin(margin);
+        int n = rand() % 3000;
+        for (int i = 0; i < n; ++i) {
+            oaCoord coord = rand() % range;
+            oaCoord low = rand() % range;
+            oaCoord high = low + rand() % (range / 4);
+            oaInt4 net = rand() % 6 - 1;
+            line_t seg(oaPoint(i, low), oaPoint(i, high));
+            reference.insert(coord, net, seg);
+            index.insert(coord, low, high, net, seg);
+            if (rand() % 50 == 0) {
+                query(reference, index, trial, range, 20);
+            }
+            if (rand() % 500 == 0) {
+                // a copy must not see what is inserted into the original
+                BarrierIndex_t copy(index);
+                Reference_t copyReference(reference);
+                for (int j = 0; j < 100; ++j) {
+                    oaCoord at = rand() % range;
+                    index.insert(at, at, at + 10, 0, line_t(oaPoint(-1, at), \
+                                oaPoint(-1, at + 10)));
+                }
+                query(copyReference, copy, trial, range, 50);
+                index = copy;
+            }
+            if (rand() % 1000 == 0) {
+                oaInt4 net = rand() % 6 - 1;
+                reference.eraseNet(net);
+                index.eraseNet(net);
+            }
+        }
+        if (index.size() != reference.size()) {
+            cerr << "trial " << trial << ": size " << index.size() << " instead of " \
+                 << reference.size() << endl;
+            ++failures;
+        }
+        query(reference, index, trial, range, 200);
+        barriers += n;
+    }
+    if (failures != 0) {
+        cerr << failures << " mismatches" << endl;
+        return 1;
+    }
+    cout << "barrierindex: 200 sets, " << barriers << " barriers ok" << endl;
+    return 0;
+}
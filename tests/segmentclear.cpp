@@ -0,0 +1,112 @@
+// segmentclear: Router_t::segmentClear against foreign metal running
+// alongside a segment past both of its ends, which only the line sets see,
+// and against the metal2 pads of foreign contacts, which reRoute() must
+// replace rather than add to
+#include <iostream>
+#include <fstream>
+#include <string>
+#include "MemoryBackend.h"
+#include "Router.h"
+
+using namespace oa;
+using namespace std;
+
+// the layer numbers of Router.cpp
+static const oaLayerNum METAL1 = 8;
+static const oaLayerNum METAL2 = 12;
+
+// RouterCheck_t: friend of Router_t, reaches the private primitives
+class RouterCheck_t {
+public:
+    explicit RouterCheck_t(Router_t &router) : _router(router), _failures(0) {}
+    void addObstacle(oaLayerNum layer, oaInt4 netID, const oaBox &box) {
+        _router.addObstacle(layer, netID, box);
+    }
+    void expectClear(const oaPoint &from, const oaPoint &to, oaInt4 netID, bool clear);
+    void expectPads(size_t pads);
+    int failures() const { return _failures; }
+private:
+    Router_t &_router;
+    int _failures;
+};
+
+void
+RouterCheck_t::expectClear(const oaPoint &from, const oaPoint &to, oaInt4 netID, \
+        bool clear)
+{
+    if (_router.segmentClear(from, to, netID) != clear) {
+        cerr << "segmentClear((" << from.x() << "," << from.y() << "), (" << to.x() \
+             << "," << to.y() << "), net " << netID << ") should be " \
+             << (clear ? "true" : "false") << endl;
+        ++_failures;
+    }
+}
+
+void
+RouterCheck_t::expectPads(size_t pads)
+{
+    if (_router._m2Pads.size() != pads) {
+        cerr << _router._m2Pads.size() << " pad edges, should be " << pads << endl;
+        ++_failures;
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+    // metal width and spacing 60, via extension 20, vias 60 x 60
+    string prefix = (argc > 1) ? argv[1] : "tests/segmentclear";
+    ofstream((prefix + ".rule").c_str()) << "6 6 2 60 6 6" << endl;
+    // one net, its contacts centred on (1500,1400) and (1500,2400)
+    ofstream((prefix + ".txt").c_str()) << "1470 1370 1470 2370 S" << endl;
+    oaBox VDDBox(0, 2970, 3000, 3150);
+    oaBox VSSBox(0, -90, 3000, 90);
+    MemoryBackend_t backend(VDDBox, VSSBox);
+    streambuf *coutBuffer = cout.rdbuf();
+    ofstream devNull("/dev/null");
+    cout.rdbuf(devNull.rdbuf());
+    Router_t router(backend, (prefix + ".txt").c_str(), (prefix + ".rule").c_str());
+    cout.rdbuf(coutBuffer);
+    RouterCheck_t check(router);
+
+    // a foreign metal1 wire, net 1 routes vertical segments beside it: a
+    // wire centre line needs 60 + 30 from its edges
+    check.addObstacle(METAL1, 9999, oaBox(700, 200, 760, 2000));
+    check.expectClear(oaPoint(740, 800), oaPoint(740, 1200), 1, false);
+    check.expectClear(oaPoint(790, 800), oaPoint(790, 1200), 1, false);
+    check.expectClear(oaPoint(820, 800), oaPoint(820, 1200), 1, false);
+    check.expectClear(oaPoint(850, 800), oaPoint(850, 1200), 1, true);
+    check.expectClear(oaPoint(610, 800), oaPoint(610, 1200), 1, true);
+    check.expectClear(oaPoint(740, 800), oaPoint(740, 1200), 9999, true);
+    // beyond its end: with its via the segment reaches 50 below its start
+    check.expectClear(oaPoint(740, 2110), oaPoint(740, 2400), 1, true);
+    check.expectClear(oaPoint(740, 2100), oaPoint(740, 2400), 1, false);
+
+    // the same on metal2 with a horizontal wire
+    check.addObstacle(METAL2, 9999, oaBox(200, 700, 2000, 760));
+    check.expectClear(oaPoint(800, 740), oaPoint(1200, 740), 1, false);
+    check.expectClear(oaPoint(800, 790), oaPoint(1200, 790), 1, false);
+    check.expectClear(oaPoint(800, 850), oaPoint(1200, 850), 1, true);
+    check.expectClear(oaPoint(800, 740), oaPoint(1200, 740), 9999, true);
+
+    // a via on the contact at (1500,1400) needs metal2 from 1450 to 1550
+    check.expectClear(oaPoint(1000, 1400), oaPoint(1340, 1400), 9999, true);
+    check.expectClear(oaPoint(1000, 1400), oaPoint(1350, 1400), 9999, false);
+    check.expectClear(oaPoint(1300, 1400), oaPoint(1700, 1400), 9999, false);
+    check.expectClear(oaPoint(1300, 1490), oaPoint(1700, 1490), 9999, false);
+    check.expectClear(oaPoint(1300, 1520), oaPoint(1700, 1520), 9999, true);
+
+    // reRoute() starts over from the contacts, two pad edges each
+    check.expectPads(4);
+    cout.rdbuf(devNull.rdbuf());
+    router.reRoute();
+    cout.rdbuf(coutBuffer);
+    check.expectPads(4);
+
+    if (check.failures() != 0) {
+        cerr << check.failures() << " failures" << endl;
+        return 1;
+    }
+    cout << "segmentclear: foreign wires and pads alongside segments ok" << endl;
+    return 0;
+}
@@ -0,0 +1,102 @@
+// tracedecode: print the records of a trace written by a ROUTER_TRACE
+// build as one timeline, merged across threads in time order
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include "Trace.h"
+
+using namespace oa;
+using namespace std;
+
+// DecodedRecord_t: a record and the thread that wrote it
+typedef struct {
+    TraceRecord_t record;
+    oaUInt4 thread;
+} DecodedRecord_t;
+
+static bool
+earlier(const DecodedRecord_t &lhs, const DecodedRecord_t &rhs)
+{
+    return lhs.record.time < rhs.record.time;
+}
+
+static const char *
+eventName(unsigned event)
+{
+    static const char *names[] = {"escape", "escapeLine", "escapePointI", \
+        "escapePointII", "cover", "wire"};
+    return event < sizeof(names) / sizeof(names[0]) ? names[event] : "unknown";
+}
+
+static const char *
+orientName(unsigned orient)
+{
+    static const char *names[] = {"H", "V", "HV"};
+    return orient < sizeof(names) / sizeof(names[0]) ? names[orient] : "?";
+}
+
+static void
+printLine(const oaInt4 *line)
+{
+    cout << " (" << line[0] << ", " << line[1] << ")-(" << line[2] << ", " << line[3] << ")";
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2 || argc > 3) {
+        cerr << "Usage: " << argv[0] << " trace_file [net_id]" << endl;
+        return 1;
+    }
+    ifstream file(argv[1], ios::in | ios::binary);
+    TraceFileHeader_t header;
+    if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) || \
+            memcmp(header.magic, "RTRC", 4) != 0 || header.version != 1 || \
+            header.recordSize != sizeof(TraceRecord_t)) {
+        cerr << "Invalid trace file: " << argv[1] << endl;
+        return 1;
+    }
+    bool filter = argc == 3;
+    oaInt4 netID = filter ? atoi(argv[2]) : 0;
+
+    vector<DecodedRecord_t> records;
+    for (oaUInt4 i = 0; i < header.threads; ++i) {
+        TraceThreadHeader_t threadHeader;
+        if (!file.read(reinterpret_cast<char *>(&threadHeader), sizeof(threadHeader))) {
+            cerr << "Truncated trace file: " << argv[1] << endl;
+            return 1;
+        }
+        DecodedRecord_t decoded;
+        decoded.thread = threadHeader.thread;
+        for (oaUInt4 j = 0; j < threadHeader.records; ++j) {
+            if (!file.read(reinterpret_cast<char *>(&decoded.record), sizeof(TraceRecord_t))) {
+                cerr << "Truncated trace file: " << argv[1] << endl;
+                return 1;
+            }
+            if (!filter || decoded.record.netID == netID) {
+                records.push_back(decoded);
+            }
+        }
+    }
+    stable_sort(records.begin(), records.end(), earlier);
+
+    // time in microseconds since the first record
+    vector<DecodedRecord_t>::const_iterator it;
+    for (it = records.begin(); it != records.end(); ++it) {
+        const TraceRecord_t &record = it->record;
+        cout << (record.time - records.front().record.time) / 1e3 << "us";
+        cout << " t" << it->thread << " net " << record.netID << " ";
+        cout << eventName(record.event) << " " << orientName(record.orient);
+        cout << " (" << record.x << ", " << record.y << ")";
+        if (record.sides & 1) {
+            printLine(record.low);
+        }
+        if (record.sides & 2) {
+            printLine(record.high);
+        }
+        cout << endl;
+    }
+    return 0;
+}